@@ -1,7 +1,9 @@
 #include "browser.h"
 #include "match_rule.h"
+#include "rule_table.h"
 #include <filesystem>
 #include <algorithm>
+#include <unordered_map>
 #include "win32/shell.h"
 #include "win32/os.h"
 #include "win32/uwp.h"
@@ -51,8 +53,8 @@ namespace bt {
     }
 
     bool browser::contains_profile_id(const std::string& long_id) const {
-        for(const auto i : instances) {
-            if(i->long_id() == long_id) return true;
+        for(const auto& i : instances) {
+            if(i->has_long_id(long_id)) return true;
         }
         return false;
     }
@@ -79,7 +81,7 @@ namespace bt {
         // try to find
         for (auto b : browsers) {
             for (auto& p : b->instances) {
-                if (p->long_id() == long_id) {
+                if (p->has_long_id(long_id)) {
                     found = true;
                     return p;
                 }
@@ -95,29 +97,39 @@ namespace bt {
         const click_payload& up,
         const string& default_profile_long_id,
         const script_site& script) {
+        return match(rule_table::build(browsers), browsers, up, default_profile_long_id, script);
+    }
+
+    std::vector<browser_match_result> browser::match(
+        const rule_table& rules,
+        const std::vector<shared_ptr<browser>>& browsers,
+        const click_payload& up,
+        const string& default_profile_long_id,
+        const script_site& script,
+        std::pmr::memory_resource* mem) {
+        return to_results(rules, browsers, rules.match(up, script, mem), default_profile_long_id);
+    }
+
+    std::vector<browser_match_result> browser::to_results(
+        const rule_table& rules,
+        const std::vector<shared_ptr<browser>>& browsers,
+        std::span<const rule_table::hit> hits,
+        const string& default_profile_long_id) {
         vector<browser_match_result> r;
 
-        // which browser should we use?
-        for (auto b : browsers) {
-            for (auto i : b->instances) {
-                match_rule mr{ "" };
-                if (i->is_match(up, script, mr)) {
-                    r.emplace_back(i, mr);
-                }
-            }
+        // which browser should we use? hits are already sorted by priority
+        r.reserve(max<size_t>(hits.size(), 1));
+        for(const rule_table::hit& h : hits) {
+            r.emplace_back(rules.get_instance(h.instance), rules.get_rule(h.rule));
         }
 
         if (r.empty() && !browsers.empty()) {
-            match_rule fbr{"default"};
-            fbr.is_fallback = true;
-            r.emplace_back(get_default(browsers, default_profile_long_id), fbr);
-        }
-
-        // sort by priority, descending
-        if(r.size() > 1) {
-            std::sort(r.begin(), r.end(), [](const browser_match_result& a, const browser_match_result& b) {
-                return a.rule.priority > b.rule.priority;
-            });
+            static const shared_ptr<const match_rule> fallback_rule = []() {
+                auto fbr = make_shared<match_rule>("default");
+                fbr->is_fallback = true;
+                return fbr;
+            }();
+            r.emplace_back(get_default(browsers, default_profile_long_id), fallback_rule);
         }
 
         return r;
@@ -134,42 +146,48 @@ namespace bt {
 
     std::vector<std::shared_ptr<browser>> browser::merge(
         std::vector<std::shared_ptr<browser>> new_set, std::vector<std::shared_ptr<browser>> old_set) {
-        
-        // todo: this would be nice to rewrite in modern functional C++
+
         vector<shared_ptr<browser>> r;
 
+        // index old browsers by open_cmd, first one wins just like a linear search would
+        unordered_map<string, shared_ptr<browser>> old_by_cmd;
+        old_by_cmd.reserve(old_set.size());
+        for(const auto& b_old : old_set) {
+            old_by_cmd.try_emplace(b_old->open_cmd, b_old);
+        }
+
         for (shared_ptr<browser> b_new : new_set) {
             // find corresponding browser by open_cmd
-            auto b_old_it = std::find_if(
-                old_set.begin(), old_set.end(),
-                [b_new](shared_ptr<browser> el) { return el->open_cmd == b_new->open_cmd; });
+            auto b_old_it = old_by_cmd.find(b_new->open_cmd);
 
-            if (b_old_it != old_set.end()) {
-                shared_ptr<browser> b_old = *b_old_it;
+            if (b_old_it != old_by_cmd.end()) {
+                shared_ptr<browser> b_old = b_old_it->second;
 
                 // merge user data
                 b_new->is_hidden = b_old->is_hidden;
                 b_new->sort_order = b_old->sort_order;
 
                 // profiles
+                unordered_map<string, shared_ptr<browser_instance>> old_by_id;
+                old_by_id.reserve(b_old->instances.size());
+                for(const auto& bi_old : b_old->instances) {
+                    old_by_id.try_emplace(bi_old->id, bi_old);
+                }
 
                 // merge old data into new profiles
                 for (shared_ptr<browser_instance> bi_new : b_new->instances) {
-                    auto bi_old_it = std::find_if(
-                        b_old->instances.begin(), b_old->instances.end(),
-                        [bi_new](shared_ptr<browser_instance> el) {return el->id == bi_new->id; });
-
-                    if (bi_old_it == b_old->instances.end()) continue;
-                    shared_ptr<browser_instance> bi_old = *bi_old_it;
+                    auto bi_old_it = old_by_id.find(bi_new->id);
+                    if (bi_old_it == old_by_id.end()) continue;
+                    shared_ptr<browser_instance> bi_old = bi_old_it->second;
 
                     // merge user-defined customisations
                     bi_new->user_arg = bi_old->user_arg;
                     bi_new->user_icon_path = bi_old->user_icon_path;
+                    bi_new->is_hidden = bi_old->is_hidden;
+                    bi_new->sort_order = bi_old->sort_order;
 
-                    // merge rules
-                    for (auto& rule : bi_old->rules) {
-                        bi_new->add_rule(rule->value);
-                    }
+                    // merge rules, keeping all of their settings rather than re-parsing the value only
+                    bi_new->add_rules(bi_old->rules);
                 }
             }
 
@@ -272,28 +290,6 @@ namespace bt {
         }
     }
 
-    bool browser_instance::is_match(const click_payload& up, match_rule& mr) const {
-        for (const auto& rule : rules) {
-            if (rule->is_match(up)) {
-                mr = *rule;
-                return true;
-            }
-        }
-
-        return false;
-    }
-
-    bool browser_instance::is_match(const click_payload& up, const script_site& ss, match_rule& mr) const {
-        for(const auto& rule : rules) {
-            if(rule->is_match(up, ss)) {
-                mr = *rule;
-                return true;
-            }
-        }
-
-        return false;
-    }
-
     bool browser_instance::add_rule(const std::string& rule_text) {
         auto new_rule = make_shared<match_rule>(rule_text);
 
@@ -307,6 +303,23 @@ namespace bt {
         return true;
     }
 
+    size_t browser_instance::add_rules(const std::vector<std::shared_ptr<match_rule>>& new_rules) {
+        unordered_set<string> seen;
+        seen.reserve(rules.size() + new_rules.size());
+        for(const auto& rule : rules) {
+            seen.insert(rule->get_identity());
+        }
+
+        size_t added{0};
+        for(const auto& rule : new_rules) {
+            if(seen.insert(rule->get_identity()).second) {
+                rules.push_back(make_shared<match_rule>(*rule));
+                added++;
+            }
+        }
+        return added;
+    }
+
     void browser_instance::delete_rule(const std::string& rule_text) {
         std::erase_if(rules, [rule_text](auto r) { return r->value == rule_text; });
     }
@@ -341,13 +354,17 @@ namespace bt {
     }
 
     void browser_instance::set_rules_from_text(std::vector<std::string> rules_txt) {
+        vector<shared_ptr<match_rule>> parsed;
+        parsed.reserve(rules_txt.size());
         for (const string& rule : rules_txt) {
             string clean_rule = rule;
             str::trim(clean_rule);
             if(!clean_rule.empty()) {
-                add_rule(rule);
+                parsed.push_back(make_shared<match_rule>(rule));
             }
         }
+
+        add_rules(parsed);
     }
 
     void browser_instance::launch_win32_process_and_foreground(const std::string& cmdline) const {
@@ -1,9 +1,14 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
+#include <memory_resource>
+#include <span>
+#include <unordered_set>
 #include "match_rule.h"
 #include "click_payload.h"
+#include "rule_table.h"
 
 namespace bt {
 
@@ -99,6 +104,27 @@ namespace bt {
             const std::string& default_profile_long_id,
             const script_site& script);
 
+        /**
+         * @brief Same as above, but uses a prebuilt rule table. Browsers are only needed for the fallback.
+         * @param mem where temporaries are allocated, normally a click_arena. The result is not.
+         */
+        static std::vector<browser_match_result> match(
+            const rule_table& rules,
+            const std::vector<std::shared_ptr<browser>>& browsers,
+            const click_payload& up,
+            const std::string& default_profile_long_id,
+            const script_site& script,
+            std::pmr::memory_resource* mem = std::pmr::get_default_resource());
+
+        /**
+         * @brief Turns rule table hits into match results, or falls back to the default profile when there are none.
+         */
+        static std::vector<browser_match_result> to_results(
+            const rule_table& rules,
+            const std::vector<std::shared_ptr<browser>>& browsers,
+            std::span<const rule_table::hit> hits,
+            const std::string& default_profile_long_id);
+
         static std::shared_ptr<browser_instance> get_default(
             const std::vector<std::shared_ptr<browser>>& browsers,
             const std::string& default_profile_long_id);
@@ -140,10 +166,6 @@ namespace bt {
 
         void launch(click_payload up) const;
 
-        bool is_match(const click_payload& up, match_rule& mr) const;
-
-        bool is_match(const click_payload& up, const script_site& ss, match_rule& mr) const;
-
         /// <summary>
         /// Adds a rule from text. Does not persist.
         /// </summary>
@@ -151,6 +173,12 @@ namespace bt {
         /// <returns>true if rule was added - if duplicate is found it's not added.</returns>
         bool add_rule(const std::string& rule_text);
 
+        /**
+         * @brief Adds copies of rules, skipping duplicates of existing rules and of each other. Linear in the number of rules.
+         * @return number of rules added
+         */
+        size_t add_rules(const std::vector<std::shared_ptr<match_rule>>& new_rules);
+
         void delete_rule(const std::string& rule_text);
 
         std::shared_ptr<browser> b;     // browser it belongs to
@@ -209,6 +237,14 @@ namespace bt {
 
         std::string long_id() const { return b->id + ":" + id; }
 
+        /**
+         * @brief Same as comparing to long_id(), but without building a string.
+         */
+        bool has_long_id(std::string_view long_id) const {
+            return long_id.size() == b->id.size() + 1 + id.size() &&
+                long_id.starts_with(b->id) && long_id[b->id.size()] == ':' && long_id.ends_with(id);
+        }
+
         bool is_singular() const; // whether this is a singular instance browser (private mode is not taken into account)
 
         std::string get_best_display_name() const;
@@ -224,6 +260,6 @@ namespace bt {
 
     struct browser_match_result {
         std::shared_ptr<browser_instance> bi;
-        match_rule rule;
+        std::shared_ptr<const match_rule> rule;
     };
 }
\ No newline at end of file
@@ -0,0 +1,31 @@
+#include "click_arena.h"
+
+using namespace std;
+
+namespace bt {
+
+    click_arena::click_arena()
+        : heap{pmr::get_default_resource(), st.heap_allocations},
+        pool{buffer, sizeof(buffer), &heap},
+        counter{&pool, st.allocations, &st.bytes} {
+    }
+
+    void click_arena::release() {
+        pool.release();
+        st = stats{};
+    }
+
+    void* click_arena::counting_resource::do_allocate(size_t size, size_t alignment) {
+        allocations += 1;
+        if(bytes) *bytes += size;
+        return upstream->allocate(size, alignment);
+    }
+
+    void click_arena::counting_resource::do_deallocate(void* p, size_t size, size_t alignment) {
+        upstream->deallocate(p, size, alignment);
+    }
+
+    bool click_arena::counting_resource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+        return this == &other;
+    }
+}
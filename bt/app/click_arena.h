@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+
+namespace bt {
+
+    /**
+     * @brief Memory for temporaries created while routing a single click. Allocations come from an inline buffer and
+     * are all released at once when the arena goes away. If a click needs more, the arena grows from the heap.
+     */
+    class click_arena {
+    public:
+
+        /**
+         * @brief Enough for a typical click, so that nothing reaches the heap.
+         */
+        static constexpr size_t InlineSize = 16 * 1024;
+
+        struct stats {
+            /**
+             * @brief Number of allocations served by the arena.
+             */
+            size_t allocations{0};
+
+            size_t bytes{0};
+
+            /**
+             * @brief Number of times the arena had to grow from the heap.
+             */
+            size_t heap_allocations{0};
+        };
+
+        click_arena();
+        click_arena(const click_arena&) = delete;
+        click_arena& operator=(const click_arena&) = delete;
+
+        std::pmr::memory_resource* get() { return &counter; }
+
+        const stats& get_stats() const { return st; }
+
+        /**
+         * @brief Releases everything allocated so far, so the arena can be reused for the next click.
+         */
+        void release();
+
+    private:
+
+        /**
+         * @brief Counts allocations passing through to the upstream resource.
+         */
+        class counting_resource : public std::pmr::memory_resource {
+        public:
+            counting_resource(std::pmr::memory_resource* upstream, size_t& allocations, size_t* bytes = nullptr)
+                : upstream{upstream}, allocations{allocations}, bytes{bytes} {}
+
+        protected:
+            void* do_allocate(size_t size, size_t alignment) override;
+            void do_deallocate(void* p, size_t size, size_t alignment) override;
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+        private:
+            std::pmr::memory_resource* upstream;
+            size_t& allocations;
+            size_t* bytes;
+        };
+
+        stats st;
+        alignas(std::max_align_t) std::byte buffer[InlineSize];
+        counting_resource heap;
+        std::pmr::monotonic_buffer_resource pool;
+        counting_resource counter;
+    };
+}
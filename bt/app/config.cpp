@@ -6,14 +6,20 @@
 #include "str.h"
 #include <fmt/core.h>
 #include <filesystem>
+#include <unordered_map>
+#include <numeric>
+#include <execution>
+#include <algorithm>
 #include "fss.h"
 #include "hashing.h"
+#include "matching/domain_list.h"
 
 using namespace std;
 namespace fs = std::filesystem;
 
 namespace bt {
     #define ConfigFileName "config.ini"
+    #define DecisionCacheFileName "decisions.cache"
     #define settings_root "SOFTWARE\\" APP_LONG_NAME
     #define BrowserPrefix "browser"
     #define IsHidden "hidden"
@@ -57,12 +63,24 @@ namespace bt {
     #define PipelineSubstituteKey "substitute"
     #define PipelineScriptKey "script"
     #define PipeVisualiserSectionName "pipevis"
+    #define ScriptSectionName "script"
+    #define ScriptGcModeKey "gc_mode"
+    #define ScriptGcStepSizeKey "gc_step_size"
 
     config::config() : cfg{config::get_data_file_path(ConfigFileName)} {
+        // relative domain list paths in rules are relative to the configuration file
+        matching::domain_list::configure(
+            fs::path{get_data_file_path(ConfigFileName)}.parent_path().string(),
+            get_data_file_path("lists"));
+
         migrate();
         load();
     }
 
+    bool config::open_decision_cache(decision_cache& cache) {
+        return cache.open(get_data_file_path(DecisionCacheFileName));
+    }
+
     std::string config::get_data_file_path(const std::string& name) {
         return fs::exists(fs::path{fss::get_current_dir()} / PortableMarkerName)
             ? (fs::path{fss::get_current_dir()} / name).string()
@@ -194,172 +212,462 @@ namespace bt {
         pipeline_substitutions = cfg.get_all_values(PipelineSubstKeyName, PipelineSectionName);
         pipeline_script = cfg.get_bool_value(PipelineScriptKey, true, PipelineSectionName);
 
+        // scripting
+        script_gc_generational = cfg.get_value(ScriptGcModeKey, ScriptSectionName) == "generational";
+        script_gc_step_size = cfg.get_int_value(ScriptGcStepSizeKey, 0, ScriptSectionName);
+
         // pipe visualiser
         pv_last_url = cfg.get_value("last_url", PipeVisualiserSectionName);
         pv_last_wt = cfg.get_value("last_wt", PipeVisualiserSectionName);
         pv_last_pn = cfg.get_value("last_pn", PipeVisualiserSectionName);
 
-        browsers = load_browsers();
+        browsers = load_browsers(cfg);
+        reindex();
+
+        // remember what's on disk, so that only changes are written back
+        persisted = snapshot();
+
+        // browser sections that didn't make it into the model (i.e. leftovers) are deleted on next write
+        for(const string& sn : cfg.list_sections()) {
+            if(sn.starts_with(BrowserPrefix) && !persisted.contains(sn)) {
+                persisted[sn];
+            }
+        }
     }
 
     void config::commit() {
-        cfg.set_value(ShowHiddenBrowsersKey, show_hidden_browsers);
-        cfg.set_value(DiscoverClassicFirefoxProfilesKey, discover_classic_firefox_profiles);
-        cfg.set_value(DiscoverFirefoxContainersKey, discover_firefox_containers);
-        cfg.set_value("theme", theme_id == "follow_os" ? "" : theme_id);
-        cfg.set_value(LogRuleHitsKey, log_rule_hits);
-        cfg.set_value(DefaultProfileKey, default_profile_long_id);
-        cfg.set_value(ToastOnOpenKey, toast_on_open);
-        cfg.set_value(ToastVisibleSecsKey, toast_visible_secs);
-        cfg.set_value(ToastBorderWidthKey, toast_border_width);
-        cfg.set_value(IconOverlayKey, icon_overlay_mode_to_string(icon_overlay));
+        normalise_sort_order();
+        state next = snapshot();
+
+        // nothing changed since last load or commit, skip disk I/O entirely (unless the file changed outside, see
+        // hot_reload)
+        if(next == persisted) {
+            live_routing.committed(cfg.get_absolute_path(), false);
+            return;
+        }
+
+        write_atomically(next);
+        persisted = std::move(next);
+
+        // rules fingerprint already tells stale decisions apart, this only frees the space they take
+        decision_cache cache;
+        if(open_decision_cache(cache)) cache.clear();
+    }
+
+    std::vector<browser_match_result> config::match(const click_payload& up, const script_site& script,
+        decision_cache& cache, std::pmr::memory_resource* mem) const {
+
+        // one routing for the whole click, even if a new one is published meanwhile
+        shared_ptr<const routing> r = get_routing();
+        const rule_table& rules = r->rules;
+
+        if(!cache.is_open() || !rules.is_cacheable() || r->browsers.empty()) {
+            return browser::match(rules, r->browsers, up, r->default_profile_long_id, script, mem);
+        }
+
+        // default profile decides what happens when nothing matches
+        uint64_t generation = decision_cache::hash(r->default_profile_long_id, rules.get_fingerprint());
+        uint64_t key = rules.key_of(up);
+
+        decision_cache::decision d;
+        if(cache.get(key, generation, d) && d.count <= decision_cache::MaxHits) {
+            bool valid{true};
+            pmr::vector<rule_table::hit> hits{mem};
+            for(uint32_t i = 0; i < d.count && valid; i++) {
+                const decision_cache::hit& h = d.hits[i];
+                valid = h.instance < rules.instance_count() && h.rule < rules.rule_count();
+                if(valid) hits.push_back(rule_table::hit{h.rule, h.instance});
+            }
+            valid = valid && (hits.empty() || decision_cache::hash(rules.get_instance(hits[0].instance)->long_id()) == d.long_id);
+            if(valid) return browser::to_results(rules, r->browsers, hits, r->default_profile_long_id);
+        }
+
+        pmr::vector<rule_table::hit> hits = rules.match(up, script, mem);
+
+        d = decision_cache::decision{};
+        d.count = static_cast<uint32_t>(min(hits.size(), decision_cache::MaxHits));
+        for(uint32_t i = 0; i < d.count; i++) {
+            d.hits[i] = decision_cache::hit{hits[i].rule, hits[i].instance};
+        }
+        if(!hits.empty()) d.long_id = decision_cache::hash(rules.get_instance(hits[0].instance)->long_id());
+        cache.put(key, generation, d);
+
+        return browser::to_results(rules, r->browsers, hits, r->default_profile_long_id);
+    }
+
+    void config::reindex() {
+        long_id_to_profile.clear();
+        for(const auto& b : browsers) {
+            for(const auto& bi : b->instances) {
+                long_id_to_profile.try_emplace(bi->long_id(), bi);
+            }
+        }
+
+        auto r = make_shared<routing>();
+        r->browsers = browsers;
+        r->default_profile_long_id = default_profile_long_id;
+        r->rules = rule_table::build(browsers);
+        live_routing.publish(std::move(r));
+    }
+
+    void config::start_watching(script_site& script) {
+        string config_path = cfg.get_absolute_path();
+        vector<string> paths{config_path};
+        if(!script.get_path().empty()) paths.push_back(script.get_path());
+
+        watcher = make_unique<file_watcher>(paths, [this, &script, config_path](const string& path) {
+            if(path == config_path) {
+                live_routing.reload(config_path);
+            } else {
+                script.reload_if_changed();
+            }
+        });
+    }
+
+    void config::stop_watching() {
+        watcher.reset();
+    }
+
+    std::shared_ptr<const routing> config::read_routing(const std::string& path) {
+        // a separate reader, the one this instance writes through is only ever used on the UI thread
+        ::common::config c{path};
+
+        auto r = make_shared<routing>();
+        r->browsers = load_browsers(c);
+        r->default_profile_long_id = c.get_value(DefaultProfileKey);
+        r->rules = rule_table::build(r->browsers);
+        return r;
+    }
+
+    std::shared_ptr<browser_instance> config::find_profile(const std::string& long_id) const {
+        auto it = long_id_to_profile.find(long_id);
+        return it == long_id_to_profile.end() ? nullptr : it->second;
+    }
+
+    bool config::is_dirty() const {
+        return snapshot() != persisted;
+    }
+
+    config::state config::snapshot() const {
+        state s;
+
+        section& root = s[""];
+        root[ShowHiddenBrowsersKey] = show_hidden_browsers;
+        root[DiscoverClassicFirefoxProfilesKey] = discover_classic_firefox_profiles;
+        root[DiscoverFirefoxContainersKey] = discover_firefox_containers;
+        root["theme"] = theme_id == "follow_os" ? "" : theme_id;
+        root[LogRuleHitsKey] = log_rule_hits;
+        root[DefaultProfileKey] = default_profile_long_id;
+        root[ToastOnOpenKey] = toast_on_open;
+        root[ToastVisibleSecsKey] = toast_visible_secs;
+        root[ToastBorderWidthKey] = toast_border_width;
+        root[IconOverlayKey] = icon_overlay_mode_to_string(icon_overlay);
 
         // picker
-        cfg.set_value(PickerOnKeyCS, picker_on_key_cs, PickerSectionName);
-        cfg.set_value(PickerOnKeyCA, picker_on_key_ca, PickerSectionName);
-        cfg.set_value(PickerOnKeyAS, picker_on_key_as, PickerSectionName);
-        cfg.set_value(PickerOnKeyCL, picker_on_key_cl, PickerSectionName);
-        cfg.set_value(PickerOnConflict, picker_on_conflict, PickerSectionName);
-        cfg.set_value("on_no_rule", picker_on_no_rule, PickerSectionName);
-        cfg.set_value("always", picker_always, PickerSectionName);
-        cfg.set_value(PickerCloseOnFocusLoss, picker_close_on_focus_loss, PickerSectionName);
-        cfg.set_value(PickerAlwaysOnTop, picker_always_on_top, PickerSectionName);
-        cfg.set_value(PickerIconSize, picker_icon_size, PickerSectionName);
-        cfg.set_value(PickerItemPadding, picker_item_padding, PickerSectionName);
-        cfg.set_value(PickerInactiveItemAlpha, picker_inactive_item_alpha, PickerSectionName);
-        cfg.set_value(PickerShowKeyHints, picker_show_key_hints, PickerSectionName);
-        cfg.set_value(PickerBorderWidth, picker_border_width, PickerSectionName);
-        cfg.set_value(PickerShowNativeChrome, picker_show_native_chrome, PickerSectionName);
-        cfg.set_value(PickerOpacity, picker_opacity, PickerSectionName);
+        section& picker = s[PickerSectionName];
+        picker[PickerOnKeyCS] = picker_on_key_cs;
+        picker[PickerOnKeyCA] = picker_on_key_ca;
+        picker[PickerOnKeyAS] = picker_on_key_as;
+        picker[PickerOnKeyCL] = picker_on_key_cl;
+        picker[PickerOnConflict] = picker_on_conflict;
+        picker["on_no_rule"] = picker_on_no_rule;
+        picker["always"] = picker_always;
+        picker[PickerCloseOnFocusLoss] = picker_close_on_focus_loss;
+        picker[PickerAlwaysOnTop] = picker_always_on_top;
+        picker[PickerIconSize] = picker_icon_size;
+        picker[PickerItemPadding] = picker_item_padding;
+        picker[PickerInactiveItemAlpha] = picker_inactive_item_alpha;
+        picker[PickerShowKeyHints] = picker_show_key_hints;
+        picker[PickerBorderWidth] = picker_border_width;
+        picker[PickerShowNativeChrome] = picker_show_native_chrome;
+        picker[PickerOpacity] = picker_opacity;
 
         // pipeline
-        cfg.set_value(PipelineUnwrapO365Key, pipeline_unwrap_o365, PipelineSectionName);
-        cfg.set_value(PipelineUnshortenKey, pipeline_unshorten, PipelineSectionName);
-        cfg.set_value(PipelineSubstituteKey, pipeline_substitute, PipelineSectionName);
-        cfg.set_value(PipelineSubstKeyName, pipeline_substitutions, PipelineSectionName);
-        cfg.set_value(PipelineScriptKey, pipeline_script, PipelineSectionName);
+        section& pipeline = s[PipelineSectionName];
+        pipeline[PipelineUnwrapO365Key] = pipeline_unwrap_o365;
+        pipeline[PipelineUnshortenKey] = pipeline_unshorten;
+        pipeline[PipelineSubstituteKey] = pipeline_substitute;
+        pipeline[PipelineSubstKeyName] = pipeline_substitutions;
+        pipeline[PipelineScriptKey] = pipeline_script;
+
+        // scripting
+        section& script = s[ScriptSectionName];
+        script[ScriptGcModeKey] = string{script_gc_generational ? "generational" : "incremental"};
+        script[ScriptGcStepSizeKey] = script_gc_step_size;
 
         // pipe visualiser
-        cfg.set_value("last_url", pv_last_url, PipeVisualiserSectionName);
-        cfg.set_value("last_wt", pv_last_wt, PipeVisualiserSectionName);
-        cfg.set_value("last_pn", pv_last_pn, PipeVisualiserSectionName);
+        section& pv = s[PipeVisualiserSectionName];
+        pv["last_url"] = pv_last_url;
+        pv["last_wt"] = pv_last_wt;
+        pv["last_pn"] = pv_last_pn;
 
-        save_browsers(browsers);
+        snapshot_browsers(s);
 
-        cfg.commit();
+        return s;
     }
 
-    void config::save_browsers(std::vector<std::shared_ptr<browser>> browsers) {
+    void config::apply(::common::config& c, const state& from, const state& to) {
 
-        // delete all browser sections
-        auto section_names = cfg.list_sections();
-        for(auto& osn : section_names) {
-            if(osn.starts_with(BrowserPrefix))
-                cfg.delete_section(osn);
+        auto set = [&c](const string& key, const value& v, const string& section) {
+            std::visit([&](const auto& x) {
+                if(section.empty()) {
+                    c.set_value(key, x);
+                } else {
+                    c.set_value(key, x, section);
+                }
+            }, v);
+        };
+
+        // sections that are gone
+        for(const auto& [name, keys] : from) {
+            if(!name.empty() && !to.contains(name)) {
+                c.delete_section(name);
+            }
+        }
+
+        // new or changed keys
+        for(const auto& [name, keys] : to) {
+            auto it_from = from.find(name);
+            for(const auto& [key, v] : keys) {
+                if(it_from != from.end()) {
+                    auto it_key = it_from->second.find(key);
+                    if(it_key != it_from->second.end() && it_key->second == v) continue;
+                }
+                set(key, v, name);
+            }
+
+            // keys that are gone
+            if(it_from != from.end()) {
+                for(const auto& [key, v] : it_from->second) {
+                    if(keys.contains(key)) continue;
+                    if(name.empty()) {
+                        c.delete_key(key);
+                    } else {
+                        c.delete_key(key, name);
+                    }
+                }
+            }
+        }
+    }
+
+    void config::write_atomically(const state& next) {
+
+        // keep in-memory copy up to date for subsequent reads
+        apply(cfg, persisted, next);
+
+        // Apply the same changes to a copy of the file currently on disk, then replace the original in one go,
+        // so that a crash or a concurrent reader never sees a half-written file.
+        string path = cfg.get_absolute_path();
+        string tmp_path = fmt::format("{}.{}.tmp", path, ::GetCurrentProcessId());
+
+        error_code ec;
+        if(fs::exists(path)) {
+            fs::copy_file(path, tmp_path, fs::copy_options::overwrite_existing, ec);
+        }
+
+        if(!ec) {
+            {
+                ::common::config staged{tmp_path};
+                apply(staged, persisted, next);
+                staged.commit();
+            }
+
+            fs::rename(tmp_path, path, ec);
+        }
+
+        if(ec) {
+            // fall back to writing in place
+            fs::remove(tmp_path, ec);
+            cfg.commit();
         }
 
+        live_routing.committed(path, true);
+    }
+
+    void config::normalise_sort_order() {
         int order = 0;
         for(auto& b : browsers) {
             b->sort_order = order++;
-            string section = fmt::format("{}:{}", BrowserPrefix, b->id);
-            cfg.set_value("name", b->name, section);
-            cfg.set_value("cmd", b->open_cmd, section);
-            cfg.set_value(IsHidden, b->is_hidden, section);
-            cfg.set_value(Icon, b->icon_path, section);
-            cfg.set_value(ItemSortOrder, b->sort_order, section);
-            cfg.set_value(DataPath, b->data_path, section);
-            cfg.set_value(BrowserEngine, browser_engine_to_string(b->engine), section);
-            cfg.set_value(IsAutodiscovered, b->is_autodiscovered, section);
+
+            int sort_order = 0;
+            for(auto& bi : b->instances) {
+                bi->sort_order = sort_order++;
+            }
+        }
+    }
+
+    void config::snapshot_browsers(state& s) const {
+
+        // sort order is written by position, as commit() normalises it to, so that a snapshot can be taken without
+        // touching the model
+        int order = 0;
+        for(auto& b : browsers) {
+            string bsn = fmt::format("{}:{}", BrowserPrefix, b->id);
+            section& bs = s[bsn];
+            bs["name"] = b->name;
+            bs["cmd"] = b->open_cmd;
+            bs[IsHidden] = b->is_hidden;
+            bs[Icon] = b->icon_path;
+            bs[ItemSortOrder] = order++;
+            bs[DataPath] = b->data_path;
+            bs[BrowserEngine] = browser_engine_to_string(b->engine);
+            bs[IsAutodiscovered] = b->is_autodiscovered;
 
             // singular user instance
             if(!b->is_autodiscovered && b->instances.size() == 1) {
                 auto instance = b->instances[0];
-                cfg.set_value("arg", instance->launch_arg, section);
-                cfg.set_value("rule", instance->get_rules_as_text_clean(), section);
-                cfg.set_value("user_icon", instance->user_icon_path, section);
-                cfg.set_value("hide_ui", instance->launch_hide_ui, section);
+                bs["arg"] = instance->launch_arg;
+                bs["rule"] = instance->get_rules_as_text_clean();
+                bs["user_icon"] = instance->user_icon_path;
+                bs["hide_ui"] = instance->launch_hide_ui;
             } else {
                 // instances
                 int sort_order = 0;
                 for(auto& bi : b->instances) {
-                    bi->sort_order = sort_order++;
-                    string section = fmt::format("{}:{}:{}", BrowserPrefix, b->id, bi->id);
-                    cfg.set_value("name", bi->name, section);
-                    cfg.set_value("arg", bi->launch_arg, section);
-                    cfg.set_value("user_arg", bi->user_arg, section);
-                    cfg.set_value("icon", bi->icon_path, section);
-                    cfg.set_value("user_icon", bi->user_icon_path, section);
-                    cfg.set_value(IsIncognito, bi->is_incognito, section);
-                    cfg.set_value(IsHidden, bi->is_hidden, section);
-                    cfg.set_value("rule", bi->get_rules_as_text_clean(), section);
-                    cfg.set_value(ItemSortOrder, bi->sort_order, section);
+                    section& ps = s[fmt::format("{}:{}:{}", BrowserPrefix, b->id, bi->id)];
+                    ps["name"] = bi->name;
+                    ps["arg"] = bi->launch_arg;
+                    ps["user_arg"] = bi->user_arg;
+                    ps["icon"] = bi->icon_path;
+                    ps["user_icon"] = bi->user_icon_path;
+                    ps[IsIncognito] = bi->is_incognito;
+                    ps[IsHidden] = bi->is_hidden;
+                    ps["rule"] = bi->get_rules_as_text_clean();
+                    ps[ItemSortOrder] = sort_order++;
                 }
             }
         }
     }
 
-    std::vector<std::shared_ptr<browser>> config::load_browsers() {
-
-        vector<shared_ptr<browser>> r;
-
-        auto section_names = cfg.list_sections();
-        for(auto& bsn : section_names) {
-            vector<string> parts = str::split(bsn, ":");
-            if(parts[0] != BrowserPrefix || parts.size() != 2) continue;
+    std::vector<std::shared_ptr<browser>> config::load_browsers(::common::config& c) {
+
+        // raw values of a single section, read from the ini before any objects are built
+        struct section_values {
+            string id;
+            string name;
+            string cmd_or_icon;
+            string arg;
+            string user_arg;
+            string user_icon;
+            string engine;
+            string data_path;
+            bool is_hidden{false};
+            bool is_incognito{false};
+            bool is_autodiscovered{false};
+            bool hide_ui{false};
+            int sort_order{0};
+            vector<string> rules;
+        };
+
+        struct browser_entry {
+            section_values browser;
+            vector<section_values> profiles;
+        };
+
+        // Parse every section name exactly once and group profile sections under their browser. Profiles may appear
+        // before their browser section, so the index is keyed on browser id and ordered by first appearance.
+        vector<browser_entry> index;
+        unordered_map<string, size_t> id_to_index;
+        vector<bool> has_browser_section;
+        auto entry_for = [&](const string& b_id) -> size_t {
+            auto [it, inserted] = id_to_index.try_emplace(b_id, index.size());
+            if(inserted) {
+                index.emplace_back();
+                has_browser_section.push_back(false);
+            }
+            return it->second;
+        };
+
+        for(const string& sn : c.list_sections()) {
+            vector<string> parts = str::split(sn, ":");
+            if(parts[0] != BrowserPrefix) continue;
+
+            if(parts.size() == 2) {
+                size_t idx = entry_for(parts[1]);
+                has_browser_section[idx] = true;
+                section_values& v = index[idx].browser;
+                v.id = parts[1];
+                v.name = c.get_value("name", sn);
+                v.cmd_or_icon = c.get_value("cmd", sn);
+                v.engine = c.get_value(BrowserEngine, sn);
+                v.is_hidden = c.get_bool_value(IsHidden, false, sn);
+                v.user_icon = c.get_value(Icon, sn);
+                v.sort_order = c.get_int_value(ItemSortOrder, 0, sn);
+                v.data_path = c.get_value(DataPath, sn);
+                v.is_autodiscovered = c.get_bool_value(IsAutodiscovered, false, sn);
+
+                // singular user instance lives in the browser section itself
+                if(!v.is_autodiscovered) {
+                    section_values pv;
+                    pv.arg = c.get_value("arg", sn);
+                    pv.user_icon = c.get_value("user_icon", sn);
+                    pv.rules = c.get_all_values("rule", sn);
+                    pv.hide_ui = c.get_bool_value("hide_ui", false, sn);
+                    index[idx].profiles = {pv};
+                }
+            } else if(parts.size() == 3) {
+                size_t idx = entry_for(parts[1]);
+                section_values pv;
+                pv.id = parts[2];
+                pv.name = c.get_value("name", sn);
+                pv.arg = c.get_value("arg", sn);
+                pv.cmd_or_icon = c.get_value("icon", sn);
+                pv.user_icon = c.get_value("user_icon", sn);
+                pv.user_arg = c.get_value("user_arg", sn);
+                pv.is_incognito = c.get_bool_value(IsIncognito, false, sn);
+                pv.is_hidden = c.get_bool_value(IsHidden, false, sn);
+                pv.sort_order = c.get_int_value(ItemSortOrder, 0, sn);
+                pv.rules = c.get_all_values("rule", sn);
+                index[idx].profiles.push_back(std::move(pv));
+            }
+        }
 
-            string b_id = parts[1];
+        // Build objects per browser in parallel. Rule parsing dominates here, and browsers share no state.
+        vector<shared_ptr<browser>> built(index.size());
+        vector<size_t> order(index.size());
+        iota(order.begin(), order.end(), 0);
+        for_each(execution::par, order.begin(), order.end(), [&](size_t i) {
+            if(!has_browser_section[i]) return;     // orphaned profile sections
 
-            auto b = make_shared<browser>(
-                b_id,
-                cfg.get_value("name", bsn),
-                cfg.get_value("cmd", bsn)
-            );
+            const browser_entry& e = index[i];
+            const section_values& bv = e.browser;
 
-            b->engine = to_browser_engine(cfg.get_value(BrowserEngine, bsn));
-            b->is_hidden = cfg.get_bool_value(IsHidden, false, bsn);
-            b->icon_path = cfg.get_value(Icon, bsn);
-            b->sort_order = cfg.get_int_value(ItemSortOrder, 0, bsn);
-            b->data_path = cfg.get_value(DataPath, bsn);
-            b->is_autodiscovered = cfg.get_bool_value(IsAutodiscovered, false, bsn);
+            auto b = make_shared<browser>(bv.id, bv.name, bv.cmd_or_icon);
+            b->engine = to_browser_engine(bv.engine);
+            b->is_hidden = bv.is_hidden;
+            b->icon_path = bv.user_icon;
+            b->sort_order = bv.sort_order;
+            b->data_path = bv.data_path;
+            b->is_autodiscovered = bv.is_autodiscovered;
 
             if(b->is_autodiscovered) {
-
-                // profiles, if any
-                string profile_prefix = fmt::format("{}:{}", BrowserPrefix, b_id);
-                for(auto& ssn : section_names) {
-                    vector<string> parts = str::split(ssn, ":");
-                    if(parts[0] != BrowserPrefix || parts.size() != 3 || parts[1] != b_id) continue;
-
-                    string p_sys_name = parts[2];
-
-                    auto bi = make_shared<browser_instance>(
-                        b,
-                        p_sys_name,
-                        cfg.get_value("name", ssn),
-                        cfg.get_value("arg", ssn),
-                        cfg.get_value("icon", ssn));
-                    
-                    bi->user_icon_path = cfg.get_value("user_icon", ssn);
-                    bi->user_arg = cfg.get_value("user_arg", ssn);
-                    bi->is_incognito = cfg.get_bool_value(IsIncognito, false, ssn);
-                    bi->is_hidden = cfg.get_bool_value(IsHidden, false, ssn);
-                    bi->sort_order = cfg.get_int_value(ItemSortOrder, 0, ssn);
-
-                    // rules, if any
-                    bi->set_rules_from_text(cfg.get_all_values("rule", ssn));
-
+                for(const section_values& pv : e.profiles) {
+                    auto bi = make_shared<browser_instance>(b, pv.id, pv.name, pv.arg, pv.cmd_or_icon);
+                    bi->user_icon_path = pv.user_icon;
+                    bi->user_arg = pv.user_arg;
+                    bi->is_incognito = pv.is_incognito;
+                    bi->is_hidden = pv.is_hidden;
+                    bi->sort_order = pv.sort_order;
+                    bi->set_rules_from_text(pv.rules);
                     b->instances.push_back(bi);
                 }
-            } else {
-                auto uprof = make_shared<browser_instance>(b, "default", b->name, cfg.get_value("arg", bsn), "");
-                uprof->user_icon_path = cfg.get_value("user_icon", bsn);
-                uprof->set_rules_from_text(cfg.get_all_values("rule", bsn));
-                uprof->launch_hide_ui = cfg.get_bool_value("hide_ui", false, bsn);
+            } else if(!e.profiles.empty()) {
+                const section_values& pv = e.profiles[0];
+                auto uprof = make_shared<browser_instance>(b, "default", b->name, pv.arg, "");
+                uprof->user_icon_path = pv.user_icon;
+                uprof->set_rules_from_text(pv.rules);
+                uprof->launch_hide_ui = pv.hide_ui;
                 b->instances.push_back(uprof);
             }
 
+            built[i] = b;
+        });
+
+        vector<shared_ptr<browser>> r;
+        r.reserve(built.size());
+        for(auto& b : built) {
             // skip browsers with no instances (could be a bug or user's dirty hands)
-            if(!b->instances.empty()) {
+            if(b && !b->instances.empty()) {
                 r.push_back(b);
             }
         }
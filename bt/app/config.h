@@ -2,8 +2,16 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <unordered_map>
+#include <variant>
 #include <chrono>
+#include <memory>
 #include "browser.h"
+#include "rule_table.h"
+#include "decision_cache.h"
+#include "file_watcher.h"
+#include "hot_reload.h"
 #include "config/config.h"
 
 namespace bt {
@@ -22,6 +30,16 @@ namespace bt {
         profile_only        = 3
     };
 
+    /**
+     * @brief Everything matching needs, built by config::reindex() and never changed afterwards. A click takes the
+     * current one once and uses it throughout, so that a reload while it's being routed doesn't affect it.
+     */
+    struct routing {
+        std::vector<std::shared_ptr<browser>> browsers;
+        std::string default_profile_long_id;
+        rule_table rules;
+    };
+
     class config {
     public:
         // whether to show hidden browsers in the configuration list
@@ -66,6 +84,10 @@ namespace bt {
         bool pipeline_script;
         std::vector<std::string> pipeline_substitutions;
 
+        // scripting
+        bool script_gc_generational{false};
+        int script_gc_step_size{0};     // 0 is Lua's default
+
         // pipe visualiser
         std::string pv_last_url;
         std::string pv_last_wt;
@@ -75,8 +97,62 @@ namespace bt {
         std::vector<std::shared_ptr<browser>> browsers;
 
         config();
+
+        /**
+         * @brief Writes changed keys and sections to disk. Does nothing if there were no changes since last load or commit.
+         */
         void commit();
 
+        /**
+         * @brief Whether there are any changes not yet written to disk.
+         */
+        bool is_dirty() const;
+
+        /**
+         * @brief Rebuilds lookup indexes and publishes a new routing. Call after adding, removing or replacing browsers
+         * or profiles, changing rules or the default profile.
+         */
+        void reindex();
+
+        /**
+         * @brief Routing as of last reindex() or hot reload. Thread safe.
+         */
+        std::shared_ptr<const routing> get_routing() const { return live_routing.get(); }
+
+        /**
+         * @brief Matches click against all rules, see browser::match.
+         */
+        std::vector<browser_match_result> match(const click_payload& up, const script_site& script,
+            std::pmr::memory_resource* mem = std::pmr::get_default_resource()) const {
+            std::shared_ptr<const routing> r = get_routing();
+            return browser::match(r->rules, r->browsers, up, r->default_profile_long_id, script, mem);
+        }
+
+        /**
+         * @brief Same as above, but reuses the decision made for the same click before, if the rules haven't changed
+         * since. New decisions are added to the cache. Results contain at most decision_cache::MaxHits matches.
+         */
+        std::vector<browser_match_result> match(const click_payload& up, const script_site& script,
+            decision_cache& cache, std::pmr::memory_resource* mem = std::pmr::get_default_resource()) const;
+
+        /**
+         * @brief Finds profile by its long id using the index built by reindex().
+         * @return profile or nullptr if not found
+         */
+        std::shared_ptr<browser_instance> find_profile(const std::string& long_id) const;
+
+        /**
+         * @brief Starts watching the configuration file and the script for changes made outside of the app, e.g. by
+         * deployment tooling, for as long as the app stays open. A changed file is loaded on a background thread and
+         * swapped in when ready: configuration as a new routing, the script as a new program (see
+         * script_site::reload). Clicks in flight finish with what they started with.
+         *
+         * Only routing is reloaded, other settings and the browsers shown in the settings window stay as they are.
+         * Call stop_watching() before script goes away.
+         */
+        void start_watching(script_site& script);
+        void stop_watching();
+
         std::string get_absolute_path();
 
         // experimental flags
@@ -90,15 +166,44 @@ namespace bt {
 
         static std::string get_data_file_path(const std::string& name);
 
+        /**
+         * @brief Opens the decision cache shared by all clicks. Decisions are forgotten on every commit().
+         */
+        static bool open_decision_cache(decision_cache& cache);
+
     private:
+        using value = std::variant<bool, int, float, std::string, std::vector<std::string>>;
+        using section = std::map<std::string, value>;
+        // section name to keys, root section has an empty name
+        using state = std::map<std::string, section>;
+
         ::common::config cfg;
 
+        /**
+         * @brief State as it was last loaded from or written to disk. Used to find out what needs writing.
+         */
+        state persisted;
+
+        std::unordered_map<std::string, std::shared_ptr<browser_instance>> long_id_to_profile;
+        hot_reload<routing> live_routing{&config::read_routing};
+        std::unique_ptr<file_watcher> watcher;
+
         void migrate();
         void load();
 
+        /**
+         * @brief Reads routing from a configuration file, without migrating or writing anything.
+         */
+        static std::shared_ptr<const routing> read_routing(const std::string& path);
+
+        state snapshot() const;
+        static void apply(::common::config& c, const state& from, const state& to);
+        void write_atomically(const state& next);
+
         // --- browser/instance
 
-        void save_browsers(std::vector<std::shared_ptr<browser>> browsers);
-        std::vector<std::shared_ptr<browser>> load_browsers();
+        void normalise_sort_order();
+        void snapshot_browsers(state& s) const;
+        static std::vector<std::shared_ptr<browser>> load_browsers(::common::config& c);
     };
 }
\ No newline at end of file
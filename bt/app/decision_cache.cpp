@@ -0,0 +1,122 @@
+#include "decision_cache.h"
+#include <atomic>
+#include <cstring>
+
+using namespace std;
+
+namespace bt {
+
+    const char Magic[4] = {'B', 'T', 'D', 'C'};
+
+    // 0 marks empty entries
+    static inline uint64_t nonzero(uint64_t key) {
+        return key == 0 ? 1 : key;
+    }
+
+    bool decision_cache::open(const std::string& path) {
+        if(!file.open_writable(path, FileSize)) return false;
+
+        header hdr;
+        memcpy(&hdr, file.data(), sizeof(hdr));
+        if(memcmp(hdr.magic, Magic, sizeof(Magic)) != 0 || hdr.version != Version ||
+            hdr.set_count != SetCount || hdr.ways != Ways) {
+
+            // new file, or written by a different version
+            clear();
+            memcpy(hdr.magic, Magic, sizeof(Magic));
+            hdr.version = Version;
+            hdr.set_count = SetCount;
+            hdr.ways = Ways;
+            memcpy(file.writable_data(), &hdr, sizeof(hdr));
+        }
+
+        return true;
+    }
+
+    bool decision_cache::get(std::uint64_t key, std::uint64_t generation, decision& d) {
+        if(!is_open()) return false;
+        key = nonzero(key);
+
+        entry* set = set_of(key);
+        for(uint32_t w = 0; w < Ways; w++) {
+            if(atomic_ref<uint64_t>{set[w].key}.load(memory_order_acquire) != key) continue;
+
+            // copy first, another process may be overwriting it
+            entry e;
+            memcpy(&e, &set[w], sizeof(e));
+            if(e.key != key || e.generation != generation || e.check != checksum(e) || e.count > MaxHits) continue;
+
+            atomic_ref<uint32_t>{set[w].referenced}.store(1, memory_order_relaxed);
+            d.long_id = e.long_id;
+            d.count = e.count;
+            d.hits = e.hits;
+            return true;
+        }
+
+        return false;
+    }
+
+    void decision_cache::put(std::uint64_t key, std::uint64_t generation, const decision& d) {
+        if(!is_open()) return;
+        key = nonzero(key);
+
+        entry* set = set_of(key);
+        uint32_t victim = Ways;
+
+        // same key (e.g. from older rules) or an empty entry
+        for(uint32_t w = 0; w < Ways && victim == Ways; w++) {
+            uint64_t k = atomic_ref<uint64_t>{set[w].key}.load(memory_order_relaxed);
+            if(k == key || k == 0) victim = w;
+        }
+
+        // second chance: skip and clear recently used entries, evict the first one that wasn't
+        if(victim == Ways) {
+            atomic_ref<uint8_t> hand{hands()[key % SetCount]};
+            uint32_t w = hand.load(memory_order_relaxed) % Ways;
+            for(uint32_t i = 0; i < Ways; i++, w = (w + 1) % Ways) {
+                atomic_ref<uint32_t> referenced{set[w].referenced};
+                if(referenced.load(memory_order_relaxed) == 0) break;
+                referenced.store(0, memory_order_relaxed);
+            }
+            victim = w;
+            hand.store(static_cast<uint8_t>((w + 1) % Ways), memory_order_relaxed);
+        }
+
+        entry e{};
+        e.key = key;
+        e.generation = generation;
+        e.count = static_cast<uint32_t>(min<size_t>(d.count, MaxHits));
+        e.long_id = d.long_id;
+        e.hits = d.hits;
+        e.check = checksum(e);
+
+        // readers skip the entry while it's being written, key goes in last
+        entry& target = set[victim];
+        atomic_ref<uint64_t> target_key{target.key};
+        target_key.store(0, memory_order_release);
+        target.generation = e.generation;
+        target.check = e.check;
+        target.count = e.count;
+        target.long_id = e.long_id;
+        target.hits = e.hits;
+        atomic_ref<uint32_t>{target.referenced}.store(0, memory_order_relaxed);
+        target_key.store(e.key, memory_order_release);
+    }
+
+    void decision_cache::clear() {
+        if(!is_open()) return;
+        memset(file.writable_data() + HandsOffset, 0, FileSize - HandsOffset);
+    }
+
+    std::uint64_t decision_cache::checksum(const entry& e) {
+        uint64_t h = hash(e.key);
+        h = hash(e.generation, h);
+        h = hash(e.count, h);
+        h = hash(e.long_id, h);
+        for(const hit& x : e.hits) {
+            h = hash(x.rule, h);
+            h = hash(x.instance, h);
+        }
+        return h;
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <array>
+#include <cstdint>
+#include "mapped_file.h"
+
+namespace bt {
+
+    /**
+     * @brief Routing decisions of previous clicks, kept in a small memory-mapped file shared by all bt processes, so
+     * that reopening a recently seen URL doesn't need to evaluate all the rules again.
+     *
+     * Entries are looked up by a key (hash of the click parts rules look at) and a generation (fingerprint of the
+     * rules), so changing the rules makes old entries unreachable. The file is a set-associative table of fixed size
+     * with CLOCK (second chance) eviction in each set. Readers and writers in other processes are not locked out,
+     * instead every entry carries a checksum and torn entries are treated as missing.
+     */
+    class decision_cache {
+    public:
+        static constexpr std::uint32_t Version = 1;
+        static constexpr std::uint32_t SetCount = 512;
+        static constexpr std::uint32_t Ways = 8;
+        static constexpr size_t MaxHits = 3;
+        static constexpr std::uint64_t HashBasis = 14695981039346656037ull;
+
+        struct hit {
+            std::uint32_t rule;
+            std::uint32_t instance;
+        };
+
+        /**
+         * @brief What is cached for a click: matched rules and their profiles (as rule_table indexes), best first.
+         */
+        struct decision {
+            /**
+             * @brief Hash of the long id of the first profile, to double check it's still the same profile.
+             */
+            std::uint64_t long_id{0};
+
+            /**
+             * @brief Number of hits, 0 when no rule matched. Clicks with more hits keep only the first MaxHits.
+             */
+            std::uint32_t count{0};
+
+            std::array<hit, MaxHits> hits{};
+        };
+
+        decision_cache() = default;
+
+        /**
+         * @brief Maps the cache file, creating it or starting over if it's missing or not a valid cache.
+         */
+        bool open(const std::string& path);
+
+        bool is_open() const { return file.is_open(); }
+
+        bool get(std::uint64_t key, std::uint64_t generation, decision& d);
+
+        void put(std::uint64_t key, std::uint64_t generation, const decision& d);
+
+        /**
+         * @brief Forgets all decisions.
+         */
+        void clear();
+
+        /**
+         * @brief FNV-1a, stable across processes and builds, unlike std::hash.
+         */
+        static std::uint64_t hash(std::string_view s, std::uint64_t h = HashBasis) {
+            for(char c : s) {
+                h ^= static_cast<unsigned char>(c);
+                h *= 1099511628211ull;
+            }
+            return h;
+        }
+
+        static std::uint64_t hash(std::uint64_t v, std::uint64_t h = HashBasis) {
+            for(int i = 0; i < 8; i++) {
+                h ^= (v >> (i * 8)) & 0xFF;
+                h *= 1099511628211ull;
+            }
+            return h;
+        }
+
+    private:
+        struct header {
+            char magic[4];
+            std::uint32_t version;
+            std::uint32_t set_count;
+            std::uint32_t ways;
+        };
+
+        // one cache line
+        struct entry {
+            std::uint64_t key;              // 0 for empty entries, written last
+            std::uint64_t generation;
+            std::uint64_t check;            // hash of everything else but "referenced"
+            std::uint32_t referenced;       // CLOCK bit, set on every hit
+            std::uint32_t count;
+            std::uint64_t long_id;
+            std::array<hit, MaxHits> hits;
+        };
+
+        static_assert(sizeof(entry) == 64);
+
+        // header, then CLOCK hand of each set, then entries
+        static constexpr size_t HandsOffset = sizeof(header);
+        static constexpr size_t EntriesOffset = (HandsOffset + SetCount + 63) / 64 * 64;
+        static constexpr size_t FileSize = EntriesOffset + sizeof(entry) * SetCount * Ways;
+
+        mapped_file file;
+
+        std::uint8_t* hands() const { return reinterpret_cast<std::uint8_t*>(file.writable_data() + HandsOffset); }
+
+        entry* set_of(std::uint64_t key) const {
+            return reinterpret_cast<entry*>(file.writable_data() + EntriesOffset) + (key % SetCount) * Ways;
+        }
+
+        static std::uint64_t checksum(const entry& e);
+    };
+}
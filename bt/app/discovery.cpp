@@ -7,6 +7,8 @@
 #include <filesystem>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <future>
+#include <optional>
 #include <fmt/core.h>
 #include "../globals.h"
 #include <SimpleIni.h> // https://github.com/brofield/simpleini
@@ -58,6 +60,7 @@ namespace bt {
     const string FirefoxInstancePrefix = "Firefox-";
     // any parameters to add to Chromium-based browsers
     const string ChromiumExtraArgs = " --no-default-browser-check";
+    const string DiscoveryCacheFileName = "discovery_cache.json";
 
     string get_id_from_open_cmd(const std::string& cmd) {
         // compute MD5 hash of the command, because just exe name is not unique enough, especially when almost every browser is named "chrome.exe"
@@ -206,7 +209,8 @@ namespace bt {
         return r;
     }
 
-    void discovery::discover_registry_browsers(hive h, vector<shared_ptr<browser>>& browsers, const string& ignore_proto) {
+    void discovery::discover_registry_browsers(hive h, vector<shared_ptr<browser>>& browsers, const string& ignore_proto,
+        discovery_cache& cache) {
         auto subs = enum_subkeys(h, abs_root);
 
         for (const string& sub : subs) {
@@ -223,7 +227,10 @@ namespace bt {
                 b->instance_id = get_instance_id(sub);
                 b->is_autodiscovered = true;
 
-                fingerprint(open_command, b->engine, b->data_path);
+                if(!cache.try_get_fingerprint(open_command, b->engine, b->data_path)) {
+                    fingerprint(open_command, b->engine, b->data_path);
+                    cache.store_fingerprint(open_command, b->engine, b->data_path);
+                }
 
                 // check for duplicates (HKLM & HKCU can have the same browser registered)
                 // this is possible to to operator== on browser class
@@ -243,30 +250,69 @@ namespace bt {
         }
     }
 
-    std::vector<shared_ptr<browser>> discovery::discover_browsers(const std::string& ignore_proto) {
+    std::vector<shared_ptr<browser>> discovery::discover_browsers(const std::string& ignore_proto,
+        const discovery_progress& progress) {
         vector<shared_ptr<browser>> browsers;
+        discovery_cache cache{config::get_data_file_path(DiscoveryCacheFileName)};
 
-        discover_registry_browsers(hive::local_machine, browsers, ignore_proto);
-        discover_registry_browsers(hive::current_user, browsers, ignore_proto);
+        discover_registry_browsers(hive::local_machine, browsers, ignore_proto, cache);
+        discover_registry_browsers(hive::current_user, browsers, ignore_proto, cache);
         discover_msstore_browsers(browsers);
 
-        // discover various profiles
-        for (shared_ptr<bt::browser> b : browsers) {
-            discover_chrome_profiles(b);
-            discover_firefox_profiles(b);
-            discover_other_profiles(b);
+        // Discover various profiles, one task per browser whose source files changed since last time. Each task only
+        // touches its own browser object, so the result does not depend on which task finishes first.
+        vector<future<optional<vector<string>>>> tasks(browsers.size());
+        for (size_t i = 0; i < browsers.size(); i++) {
+            shared_ptr<bt::browser> b = browsers[i];
+            if(cache.try_restore_profiles(b)) continue;
+
+            tasks[i] = std::async(std::launch::async, [b]() -> optional<vector<string>> {
+                vector<string> sources;
+                if(!discover_profiles(b, sources)) return nullopt;
+                return sources;
+            });
+        }
+
+        // collect in original order, which also makes progress reporting happen on this thread
+        for(size_t i = 0; i < tasks.size(); i++) {
+            if(tasks[i].valid()) {
+                // a failure may be transient (e.g. file being written by the browser), so it's tried again next time
+                optional<vector<string>> sources = tasks[i].get();
+                if(sources) cache.store_profiles(browsers[i], *sources);
+            }
+            if(progress) {
+                progress(i + 1, tasks.size(), browsers[i]->name);
+            }
         }
 
+        cache.commit();
+
         return browsers;
     }
 
-    void discovery::discover_chrome_profiles(shared_ptr<browser> b) {
+    bool discovery::discover_profiles(shared_ptr<browser> b, vector<string>& sources) {
+        // A broken profile file for one browser shouldn't prevent others from being discovered.
+        // In that case the browser keeps whatever profiles were found before the failure.
+        try {
+            discover_chrome_profiles(b, sources);
+            discover_firefox_profiles(b, sources);
+            discover_other_profiles(b);
+            return true;
+        } catch(const std::exception& e) {
+            string msg = fmt::format("profile discovery failed for {}: {}\n", b->name, e.what());
+            ::OutputDebugStringA(msg.c_str());
+            return false;
+        }
+    }
+
+    void discovery::discover_chrome_profiles(shared_ptr<browser> b, vector<string>& sources) {
         if (!(b->is_autodiscovered && b->engine == browser_engine::chromium)) return;
 
         // https://github.com/ScoopInstaller/Extras/blob/5d9773cbeb8cbe7b1e97061cf4819b60956a3b61/bucket/helium.json#L22
 
         fs::path root{b->data_path};
         fs::path lsjf = root / "Local State";
+        sources.push_back(lsjf.string());
 
         // faster method to discover
         if(fs::exists(lsjf)) {
@@ -379,12 +425,14 @@ namespace bt {
     }
 
 
-    void discovery::discover_firefox_profiles(std::shared_ptr<browser> b, std::vector<firefox_profile>& profiles) {
+    void discovery::discover_firefox_profiles(std::shared_ptr<browser> b, std::vector<firefox_profile>& profiles,
+        std::vector<std::string>& sources) {
 
         fs::path data_folder{b->data_path};
 
         // profiles.ini is the starting entry point to find both classic and new profiles (profile groups)
         fs::path ini_path = data_folder / "profiles.ini";
+        sources.push_back(ini_path.string());
         if(!fs::exists(ini_path)) return;
 
         CSimpleIniA ini;
@@ -440,6 +488,8 @@ namespace bt {
             const char* c_nested_store_id = ini.GetValue(e.pItem, "StoreID");
             if(c_nested_store_id) {
                 fs::path sqlite_db_path = data_folder / "Profile Groups" / (string{c_nested_store_id} + ".sqlite");
+                sources.push_back(sqlite_db_path.string());
+                sources.push_back(sqlite_db_path.string() + "-wal");
                 // profile definitions i.e. "new profiles" are now stored in the sqlite database
                 if(fs::exists(sqlite_db_path)) {
                     discover_filefox_profile_groups(section_name,
@@ -456,11 +506,11 @@ namespace bt {
         }
     }
 
-    void discovery::discover_firefox_profiles(shared_ptr<browser> b) {
+    void discovery::discover_firefox_profiles(shared_ptr<browser> b, vector<string>& sources) {
         if (!(b->is_autodiscovered && b->engine == browser_engine::gecko)) return;
 
         vector<firefox_profile> profiles;
-        discover_firefox_profiles(b, profiles);
+        discover_firefox_profiles(b, profiles, sources);
 
         // sort profiles using the following rules: is_classic, has installation_id, name
         std::sort(profiles.begin(), profiles.end(),
@@ -496,6 +546,7 @@ namespace bt {
                 // Leave the "no container" profile as is.
 
                 // add profile for each container
+                sources.push_back((fs::path{fp.path} / "containers.json").string());
                 vector<firefox_container> containers = discover_firefox_containers(fp.path);
                 for(const auto& container : containers) {
 
@@ -649,8 +700,8 @@ namespace bt {
         https = get_shell_url_association_progid("https");
     }
 
-    const std::vector<shared_ptr<browser>> discovery::discover_all_browsers() {
-        return bt::discovery::discover_browsers(ProtoName);
+    const std::vector<shared_ptr<browser>> discovery::discover_all_browsers(const discovery_progress& progress) {
+        return bt::discovery::discover_browsers(ProtoName, progress);
     }
 
     string discovery::get_shell_url_association_progid(const string& protocol_name) {
@@ -1,7 +1,9 @@
 #pragma once
 #include "browser.h"
+#include "discovery_cache.h"
 #include "win32/reg.h"
 #include <vector>
+#include <functional>
 
 namespace bt {
 
@@ -19,6 +21,12 @@ namespace bt {
         std::string name;
     };
 
+    /**
+     * @brief Discovery progress callback: number of browsers processed so far, total number of browsers, and the
+     * name of the browser that was just processed. Always invoked on the thread that called discovery.
+     */
+    using discovery_progress = std::function<void(size_t done, size_t total, const std::string& browser_name)>;
+
     /**
      * @brief Contains various methods to auto-discover browsers installed on the system.
      */
@@ -29,19 +37,30 @@ namespace bt {
 
         /**
          * @brief Scans the system for all the browsers.Also returns custom browser placeholder.
+         * @param progress Optional progress callback. Profiles are discovered in parallel, one task per browser.
          */
-        static const std::vector<std::shared_ptr<browser>> discover_all_browsers();
+        static const std::vector<std::shared_ptr<browser>> discover_all_browsers(const discovery_progress& progress = nullptr);
 
     private:
         inline static const int ICON_SIZE = 256;
 
-        static std::vector<std::shared_ptr<browser>> discover_browsers(const std::string& ignore_proto);
+        static std::vector<std::shared_ptr<browser>> discover_browsers(const std::string& ignore_proto,
+            const discovery_progress& progress);
+
+        /**
+         * @brief Discovers all profiles of a single browser. Touches nothing but the browser passed.
+         * @param sources receives paths of all files the result depends on, including ones that don't exist
+         * @return false if a profile file couldn't be read, in which case the browser has the profiles found before
+         * the failure, which must not be cached
+         */
+        static bool discover_profiles(std::shared_ptr<browser> b, std::vector<std::string>& sources);
 
-        static void discover_chrome_profiles(std::shared_ptr<browser> b);
+        static void discover_chrome_profiles(std::shared_ptr<browser> b, std::vector<std::string>& sources);
 
-        static void discover_firefox_profiles(std::shared_ptr<browser> b, std::vector<firefox_profile>& profiles);
+        static void discover_firefox_profiles(std::shared_ptr<browser> b, std::vector<firefox_profile>& profiles,
+            std::vector<std::string>& sources);
 
-        static void discover_firefox_profiles(std::shared_ptr<browser> b);
+        static void discover_firefox_profiles(std::shared_ptr<browser> b, std::vector<std::string>& sources);
 
         static void discover_filefox_profile_groups(
             const std::string& parent_id,
@@ -62,7 +81,7 @@ namespace bt {
         static std::string unmangle_open_cmd(const std::string& open_cmd);
 
         static void discover_registry_browsers(win32::reg::hive h,
-            std::vector<std::shared_ptr<browser>>& browsers, const std::string& ignore_proto);
+            std::vector<std::shared_ptr<browser>>& browsers, const std::string& ignore_proto, discovery_cache& cache);
 
         /**
          * @brief Performs browser fingerprinting based on the executable path.
@@ -0,0 +1,197 @@
+#include "discovery_cache.h"
+#include "config.h"
+#include "../globals.h"
+#include "fss.h"
+#include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <fmt/core.h>
+
+using namespace std;
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace bt {
+
+    const int CacheVersion = 1;
+
+    file_fingerprint file_fingerprint::of(const std::string& path) {
+        file_fingerprint r{path};
+
+        error_code ec;
+        auto status = fs::status(path, ec);
+        if(ec || !fs::is_regular_file(status)) return r;
+
+        r.size = fs::file_size(path, ec);
+        if(ec) return r;
+        r.mtime = fs::last_write_time(path, ec).time_since_epoch().count();
+        if(ec) return r;
+
+        r.exists = true;
+        return r;
+    }
+
+    discovery_cache::discovery_cache(const std::string& path) : path{path} {
+        load();
+    }
+
+    bool discovery_cache::try_restore_profiles(std::shared_ptr<browser> b) const {
+        string key = get_key(*b);
+        auto it = profiles.find(key);
+        if(it == profiles.end()) return false;
+
+        const profiles_entry& e = it->second;
+        for(const file_fingerprint& ff : e.sources) {
+            if(file_fingerprint::of(ff.path) != ff) return false;
+        }
+
+        for(const cached_instance& ci : e.instances) {
+            auto bi = make_shared<browser_instance>(b, ci.id, ci.name, ci.launch_arg, ci.icon_path);
+            bi->is_incognito = ci.is_incognito;
+            bi->sort_order = ci.sort_order;
+            b->instances.push_back(bi);
+        }
+
+        used.insert("p:" + key);
+        return true;
+    }
+
+    void discovery_cache::store_profiles(std::shared_ptr<browser> b, const std::vector<std::string>& sources) {
+        profiles_entry e;
+        for(const string& source : sources) {
+            e.sources.push_back(file_fingerprint::of(source));
+        }
+        for(const auto& bi : b->instances) {
+            e.instances.emplace_back(bi->id, bi->name, bi->launch_arg, bi->icon_path, bi->is_incognito, bi->sort_order);
+        }
+
+        string key = get_key(*b);
+        profiles[key] = e;
+        used.insert("p:" + key);
+        is_dirty = true;
+    }
+
+    bool discovery_cache::try_get_fingerprint(const std::string& exe_path, browser_engine& engine, std::string& data_path) const {
+        auto it = fingerprints.find(exe_path);
+        if(it == fingerprints.end() || file_fingerprint::of(exe_path) != it->second.exe) return false;
+
+        engine = it->second.engine;
+        data_path = it->second.data_path;
+        used.insert("f:" + exe_path);
+        return true;
+    }
+
+    void discovery_cache::store_fingerprint(const std::string& exe_path, browser_engine engine, const std::string& data_path) {
+        fingerprints[exe_path] = fingerprint_entry{file_fingerprint::of(exe_path), engine, data_path};
+        used.insert("f:" + exe_path);
+        is_dirty = true;
+    }
+
+    void discovery_cache::commit() {
+        if(!is_dirty) return;
+
+        auto to_json = [](const file_fingerprint& ff) {
+            return json{{"path", ff.path}, {"exists", ff.exists}, {"size", ff.size}, {"mtime", ff.mtime}};
+        };
+
+        json j_profiles = json::object();
+        for(const auto& [key, e] : profiles) {
+            if(!used.contains("p:" + key)) continue;
+
+            json j_sources = json::array();
+            for(const auto& ff : e.sources) j_sources.push_back(to_json(ff));
+
+            json j_instances = json::array();
+            for(const auto& ci : e.instances) {
+                j_instances.push_back(json{
+                    {"id", ci.id},
+                    {"name", ci.name},
+                    {"arg", ci.launch_arg},
+                    {"icon", ci.icon_path},
+                    {"incognito", ci.is_incognito},
+                    {"sort_order", ci.sort_order}});
+            }
+
+            j_profiles[key] = json{{"sources", j_sources}, {"instances", j_instances}};
+        }
+
+        json j_fingerprints = json::object();
+        for(const auto& [exe_path, e] : fingerprints) {
+            if(!used.contains("f:" + exe_path)) continue;
+
+            j_fingerprints[exe_path] = json{
+                {"exe", to_json(e.exe)},
+                {"engine", config::browser_engine_to_string(e.engine)},
+                {"data_path", e.data_path}};
+        }
+
+        json j{{"version", CacheVersion}, {"profiles", j_profiles}, {"fingerprints", j_fingerprints}};
+
+        // write to a temp file and swap, so that a half-written cache is never read
+        string tmp_path = path + ".tmp";
+        {
+            ofstream f{tmp_path, ios::out | ios::trunc};
+            if(!f) return;
+            f << j.dump();
+            if(!f) return;
+        }
+        error_code ec;
+        fs::rename(tmp_path, path, ec);
+        if(!ec) is_dirty = false;
+    }
+
+    void discovery_cache::load() {
+        if(!fs::exists(path)) return;
+
+        // cache is disposable - anything unexpected means starting from scratch
+        try {
+            json j = json::parse(fss::read_all_text(path));
+            if(j["version"] != CacheVersion) return;
+
+            auto from_json = [](const json& jf) {
+                return file_fingerprint{
+                    jf["path"].get<string>(),
+                    jf["exists"].get<bool>(),
+                    jf["size"].get<uintmax_t>(),
+                    jf["mtime"].get<int64_t>()};
+            };
+
+            for(auto& jpi : j["profiles"].items()) {
+                const json& jp = jpi.value();
+                profiles_entry e;
+                for(const auto& jf : jp["sources"]) {
+                    e.sources.push_back(from_json(jf));
+                }
+                for(const auto& ji : jp["instances"]) {
+                    e.instances.emplace_back(
+                        ji["id"].get<string>(),
+                        ji["name"].get<string>(),
+                        ji["arg"].get<string>(),
+                        ji["icon"].get<string>(),
+                        ji["incognito"].get<bool>(),
+                        ji["sort_order"].get<int>());
+                }
+                profiles[jpi.key()] = e;
+            }
+
+            for(auto& jfi : j["fingerprints"].items()) {
+                const json& jf = jfi.value();
+                fingerprints[jfi.key()] = fingerprint_entry{
+                    from_json(jf["exe"]),
+                    config::to_browser_engine(jf["engine"].get<string>()),
+                    jf["data_path"].get<string>()};
+            }
+        } catch(const std::exception&) {
+            profiles.clear();
+            fingerprints.clear();
+        }
+    }
+
+    std::string discovery_cache::get_key(const browser& b) {
+        return fmt::format("{}|{}|{}|{}|{}|{}|{}",
+            b.id, b.open_cmd, b.instance_id, b.data_path,
+            config::browser_engine_to_string(b.engine),
+            g_config.discover_classic_firefox_profiles,
+            g_config.discover_firefox_containers);
+    }
+}
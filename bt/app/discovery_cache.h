@@ -0,0 +1,91 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <cstdint>
+#include "browser.h"
+
+namespace bt {
+
+    /**
+     * @brief Identifies a version of a file on disk. A missing file is a valid state too, so that a file appearing later is noticed.
+     */
+    struct file_fingerprint {
+        std::string path;
+        bool exists{false};
+        std::uintmax_t size{0};
+        std::int64_t mtime{0};
+
+        static file_fingerprint of(const std::string& path);
+
+        bool operator==(const file_fingerprint& other) const = default;
+    };
+
+    /**
+     * @brief Persistent cache of discovery results, so that only browsers whose source files changed are re-parsed.
+     * Not thread safe - look up before and store after running parallel discovery.
+     */
+    class discovery_cache {
+    public:
+        explicit discovery_cache(const std::string& path);
+
+        /**
+         * @brief Restores profiles of a browser if none of the files they were discovered from have changed.
+         * @return true if profiles were restored
+         */
+        bool try_restore_profiles(std::shared_ptr<browser> b) const;
+
+        /**
+         * @brief Remembers discovered profiles of a browser along with the files they were discovered from.
+         */
+        void store_profiles(std::shared_ptr<browser> b, const std::vector<std::string>& sources);
+
+        /**
+         * @brief Cached version of executable fingerprinting (engine and data path), keyed on the executable file.
+         */
+        bool try_get_fingerprint(const std::string& exe_path, browser_engine& engine, std::string& data_path) const;
+
+        void store_fingerprint(const std::string& exe_path, browser_engine engine, const std::string& data_path);
+
+        /**
+         * @brief Writes cache to disk if anything was stored. Entries that were not used since load are dropped.
+         */
+        void commit();
+
+    private:
+        struct cached_instance {
+            std::string id;
+            std::string name;
+            std::string launch_arg;
+            std::string icon_path;
+            bool is_incognito{false};
+            int sort_order{0};
+        };
+
+        struct profiles_entry {
+            std::vector<file_fingerprint> sources;
+            std::vector<cached_instance> instances;
+        };
+
+        struct fingerprint_entry {
+            file_fingerprint exe;
+            browser_engine engine{browser_engine::unknown};
+            std::string data_path;
+        };
+
+        std::string path;
+        std::map<std::string, profiles_entry> profiles;
+        std::map<std::string, fingerprint_entry> fingerprints;
+        mutable std::set<std::string> used;
+        bool is_dirty{false};
+
+        void load();
+
+        /**
+         * @brief Everything apart from source files that affects discovery output for a browser.
+         */
+        static std::string get_key(const browser& b);
+    };
+}
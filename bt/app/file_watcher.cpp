@@ -0,0 +1,75 @@
+#include "file_watcher.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace bt {
+
+    file_watcher::file_watcher(std::vector<std::string> paths, callback on_change, std::chrono::milliseconds interval)
+        : on_change{std::move(on_change)}, interval{interval} {
+        for(string& path : paths) {
+            watched w;
+            w.reported = stamp_of(path);
+            w.path = std::move(path);
+            files.push_back(std::move(w));
+        }
+        t = thread{&file_watcher::run, this};
+    }
+
+    file_watcher::~file_watcher() {
+        {
+            lock_guard<mutex> lock{m};
+            stopping = true;
+        }
+        stop_requested.notify_all();
+        t.join();
+    }
+
+    file_watcher::stamp file_watcher::stamp_of(const std::string& path) {
+        stamp s;
+        error_code ec;
+        s.time = fs::last_write_time(path, ec);
+        if(ec) return s;
+        s.size = fs::file_size(path, ec);
+        if(ec) return s;
+        s.exists = true;
+        return s;
+    }
+
+    void file_watcher::run() {
+        unique_lock<mutex> lock{m};
+        while(!stop_requested.wait_for(lock, interval, [this]() { return stopping; })) {
+            lock.unlock();
+            poll();
+            lock.lock();
+        }
+    }
+
+    void file_watcher::poll() {
+        for(watched& w : files) {
+            stamp s = stamp_of(w.path);
+
+            // back to what was reported, or gone (e.g. half way through being replaced)
+            if(s == w.reported || !s.exists) {
+                w.is_pending = false;
+                continue;
+            }
+
+            // still being written
+            if(!w.is_pending || s != w.pending) {
+                w.pending = s;
+                w.is_pending = true;
+                continue;
+            }
+
+            w.reported = s;
+            w.is_pending = false;
+
+            // an exception would end the thread, and the process with it
+            try {
+                on_change(w.path);
+            } catch(...) {
+            }
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <filesystem>
+#include <cstdint>
+
+namespace bt {
+
+    /**
+     * @brief Calls back from a background thread when watched files change.
+     *
+     * Files are polled for last write time and size. A change is only reported once the file has stayed the same for
+     * a whole interval, so that a file written in several steps (or replaced with a temporary file and a rename) is
+     * reported once, when it's done. A missing file is not a change, it's reported when it's back.
+     */
+    class file_watcher {
+    public:
+        using callback = std::function<void(const std::string& path)>;
+
+        static constexpr std::chrono::milliseconds DefaultInterval{500};
+
+        /**
+         * @param on_change called with the path of a changed file, on the watcher thread, one file at a time
+         */
+        file_watcher(std::vector<std::string> paths, callback on_change,
+            std::chrono::milliseconds interval = DefaultInterval);
+        file_watcher(const file_watcher&) = delete;
+        file_watcher& operator=(const file_watcher&) = delete;
+
+        /**
+         * @brief Stops watching, waiting for a callback in progress to return.
+         */
+        ~file_watcher();
+
+        /**
+         * @brief What a change is told by.
+         */
+        struct stamp {
+            bool exists{false};
+            std::filesystem::file_time_type time;
+            std::uintmax_t size{0};
+
+            bool operator==(const stamp&) const = default;
+        };
+
+        static stamp stamp_of(const std::string& path);
+
+    private:
+        struct watched {
+            std::string path;
+            stamp reported;     // as of start or last callback
+            stamp pending;      // seen different on previous poll, reported if it's still the same on the next one
+            bool is_pending{false};
+        };
+
+        std::vector<watched> files;
+        callback on_change;
+        std::chrono::milliseconds interval;
+
+        std::mutex m;
+        std::condition_variable stop_requested;
+        bool stopping{false};
+        std::thread t;
+
+        void run();
+        void poll();
+    };
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include "file_watcher.h"
+
+namespace bt {
+
+    /**
+     * @brief Value the app builds from its own model and writes to a file, and also loads from that file when it's
+     * changed outside of the app.
+     *
+     * The model doesn't know about changes loaded from the file, so the next value built from it would drop them. They
+     * are only safe once the model is committed, as the file then has both, so after an outside change the file is loaded
+     * again on commit. Files written by the app itself are told apart by their stamp and not loaded.
+     *
+     * get() is thread safe. publish() and committed() are called on the thread owning the model, reload() on the watcher
+     * thread.
+     */
+    template<typename T>
+    class hot_reload {
+    public:
+        using reader = std::function<std::shared_ptr<const T>(const std::string& path)>;
+
+        explicit hot_reload(reader read) : read{std::move(read)} {}
+
+        std::shared_ptr<const T> get() const { return current.load(); }
+
+        /**
+         * @brief Publishes a value built from the model.
+         */
+        void publish(std::shared_ptr<const T> value) { current.store(std::move(value)); }
+
+        /**
+         * @brief Loads the file after it changed and publishes it, unless publish() did meanwhile, as that's newer.
+         * Skipped when the change is the app's own write.
+         */
+        void reload(const std::string& path) {
+            {
+                std::lock_guard<std::mutex> lock{m};
+                if(file_watcher::stamp_of(path) == own) return;
+            }
+
+            std::shared_ptr<const T> started_with = get();
+            std::shared_ptr<const T> loaded = read(path);
+            current.compare_exchange_strong(started_with, loaded);
+
+            // published or not, the model doesn't have it
+            changed_outside = true;
+        }
+
+        /**
+         * @brief Call after committing the model to the file. If the file was changed outside since the last commit,
+         * it's loaded, as it has changes from both by now.
+         * @param written false if there was nothing to write
+         */
+        void committed(const std::string& path, bool written) {
+            if(written) {
+                std::lock_guard<std::mutex> lock{m};
+                own = file_watcher::stamp_of(path);
+            }
+
+            if(changed_outside.exchange(false)) current.store(read(path));
+        }
+
+    private:
+        reader read;
+        std::atomic<std::shared_ptr<const T>> current;
+
+        /**
+         * @brief File as last written by the app.
+         */
+        std::mutex m;
+        file_watcher::stamp own;
+
+        std::atomic<bool> changed_outside{false};
+    };
+}
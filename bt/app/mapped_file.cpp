@@ -0,0 +1,163 @@
+#include "mapped_file.h"
+#if WIN32
+#include <Windows.h>
+#include "str.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace bt {
+
+    mapped_file::~mapped_file() {
+        close();
+    }
+
+#if WIN32
+
+    bool mapped_file::open(const std::string& path) {
+        close();
+
+        HANDLE h = ::CreateFileW(str::to_wstr(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(h == INVALID_HANDLE_VALUE) return false;
+        file = h;
+
+        LARGE_INTEGER sz;
+        if(!::GetFileSizeEx(h, &sz) || sz.QuadPart == 0) {
+            close();
+            return false;
+        }
+
+        mapping = ::CreateFileMappingW(h, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(!mapping) {
+            close();
+            return false;
+        }
+
+        view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if(!view) {
+            close();
+            return false;
+        }
+
+        length = static_cast<size_t>(sz.QuadPart);
+        return true;
+    }
+
+    bool mapped_file::open_writable(const std::string& path, size_t size) {
+        close();
+        if(size == 0) return false;
+
+        HANDLE h = ::CreateFileW(str::to_wstr(path).c_str(), GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(h == INVALID_HANDLE_VALUE) return false;
+        file = h;
+
+        LARGE_INTEGER sz;
+        if(!::GetFileSizeEx(h, &sz)) {
+            close();
+            return false;
+        }
+
+        if(static_cast<unsigned long long>(sz.QuadPart) != size) {
+            LARGE_INTEGER target;
+            target.QuadPart = static_cast<LONGLONG>(size);
+            if(!::SetFilePointerEx(h, target, nullptr, FILE_BEGIN) || !::SetEndOfFile(h)) {
+                close();
+                return false;
+            }
+        }
+
+        mapping = ::CreateFileMappingW(h, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+        if(!mapping) {
+            close();
+            return false;
+        }
+
+        view = ::MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0);
+        if(!view) {
+            close();
+            return false;
+        }
+
+        length = size;
+        writable = true;
+        return true;
+    }
+
+    void mapped_file::close() {
+        if(view) ::UnmapViewOfFile(view);
+        if(mapping) ::CloseHandle(mapping);
+        if(file) ::CloseHandle(file);
+        view = mapping = file = nullptr;
+        length = 0;
+        writable = false;
+    }
+
+#else
+
+    bool mapped_file::open(const std::string& path) {
+        close();
+
+        fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) return false;
+
+        struct stat st;
+        if(::fstat(fd, &st) != 0 || st.st_size == 0) {
+            close();
+            return false;
+        }
+
+        void* v = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if(v == MAP_FAILED) {
+            close();
+            return false;
+        }
+
+        view = v;
+        length = static_cast<size_t>(st.st_size);
+        return true;
+    }
+
+    bool mapped_file::open_writable(const std::string& path, size_t size) {
+        close();
+        if(size == 0) return false;
+
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if(fd < 0) return false;
+
+        struct stat st;
+        if(::fstat(fd, &st) != 0 ||
+            (static_cast<size_t>(st.st_size) != size && ::ftruncate(fd, static_cast<off_t>(size)) != 0)) {
+            close();
+            return false;
+        }
+
+        void* v = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(v == MAP_FAILED) {
+            close();
+            return false;
+        }
+
+        view = v;
+        length = size;
+        writable = true;
+        return true;
+    }
+
+    void mapped_file::close() {
+        if(view) ::munmap(view, length);
+        if(fd >= 0) ::close(fd);
+        view = nullptr;
+        fd = -1;
+        length = 0;
+        writable = false;
+    }
+
+#endif
+}
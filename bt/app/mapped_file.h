@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+namespace bt {
+
+    /**
+     * @brief Memory mapping of a whole file, read-only unless opened with open_writable().
+     */
+    class mapped_file {
+    public:
+        mapped_file() = default;
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+        ~mapped_file();
+
+        /**
+         * @brief Maps the file, closing whatever was mapped before.
+         * @return false if the file can't be opened or is empty
+         */
+        bool open(const std::string& path);
+
+        /**
+         * @brief Maps the file for reading and writing, shared with other processes mapping it. The file is created if
+         * missing and resized (zero filled when growing) if it's not exactly the size given.
+         * @return false if the file can't be created or mapped
+         */
+        bool open_writable(const std::string& path, size_t size);
+
+        void close();
+
+        bool is_open() const { return view != nullptr; }
+
+        const char* data() const { return static_cast<const char*>(view); }
+
+        /**
+         * @brief Mapped memory, or nullptr if the mapping is read-only.
+         */
+        char* writable_data() const { return writable ? static_cast<char*>(view) : nullptr; }
+
+        size_t size() const { return length; }
+
+    private:
+        void* view{nullptr};
+        size_t length{0};
+        bool writable{false};
+#if WIN32
+        void* file{nullptr};
+        void* mapping{nullptr};
+#else
+        int fd{-1};
+#endif
+    };
+}
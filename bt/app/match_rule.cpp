@@ -3,6 +3,10 @@
 #include <fmt/core.h>
 #include <regex>
 #include "strings.h"
+#include "matching/ci_search.h"
+#include "matching/regex_prefilter.h"
+#include "matching/matcher.h"
+#include "matching/predicate_dag.h"
 
 using namespace std;
 
@@ -15,6 +19,10 @@ namespace bt {
     const string AppKey = "app";
     const string TypeKey = "type";
     const string TypeRegexKey = "regex";
+    const string TypeGlobKey = "glob";
+    const string TypeListKey = "list";
+    const string TypeExprKey = "expr";
+    const string TypeExactKey = "exact";
     const string WindowTitleKey = "window_title";
     const string ProcessNameKey = "process_name";
     const string LuaScriptKey = "lua_script";
@@ -43,7 +51,11 @@ namespace bt {
                 } else if(k == ModeKey) {
                     if(v == AppKey) app_mode = true;
                 } else if(k == TypeKey) {
-                    if(v == TypeRegexKey) is_regex = true;
+                    type = to_match_type(v);
+                } else if(k == TypeListKey) {
+                    // "list:path", the path is the value
+                    type = match_type::list;
+                    value = v;
                 } else {
                     value = p;
                 }
@@ -52,6 +64,47 @@ namespace bt {
                 value = p;
             }
         }
+
+        compile();
+    }
+
+    void match_rule::compile() {
+        is_ascii_value = matching::ci_search::is_ascii(value);
+        folded_value = value;
+        matching::ci_search::fold_ascii(folded_value);
+
+        linear.reset();
+        compiled_regex.reset();
+        compiled_glob.reset();
+        domain_list.reset();
+        required_literals.clear();
+        expression.reset();
+        expression_root = 0;
+        if(type == match_type::expr) {
+            auto dag = make_shared<matching::predicate_dag>();
+            uint32_t root = dag->add(value);
+            if(root != matching::predicate_dag::NoNode) {
+                expression = dag;
+                expression_root = root;
+            }
+        } else if(type == match_type::list) {
+            domain_list = matching::domain_list::get(value);
+        } else if(type == match_type::glob) {
+            compiled_glob = make_shared<const matching::glob>(value);
+        } else if(type == match_type::regex) {
+            // prefer the linear time engine, std::regex backtracks and can take forever on some patterns
+            linear = matching::linear_regex::compile(value);
+            if(!linear) {
+                try {
+                    compiled_regex = make_shared<const regex>(value, regex_constants::icase);
+                } catch(const std::regex_error&) {
+                    // most probably invalid regex pattern, such a rule never matches
+                }
+            }
+            if(linear || compiled_regex) {
+                required_literals = matching::regex_prefilter::extract(value);
+            }
+        }
     }
 
     void match_rule::apply_to(click_payload& up) const {
@@ -59,7 +112,15 @@ namespace bt {
     }
 
     bool match_rule::operator==(const match_rule& other) const {
-        return value == other.value && scope == other.scope;
+        return value == other.value && scope == other.scope && loc == other.loc && type == other.type;
+    }
+
+    std::string match_rule::get_identity() const {
+        return fmt::format("{}|{}|{}|{}",
+            static_cast<unsigned int>(loc),
+            static_cast<unsigned int>(type),
+            static_cast<unsigned int>(scope),
+            value);
     }
 
     std::string match_rule::to_string(bool include_type) const {
@@ -70,9 +131,18 @@ namespace bt {
             return value;
         }
 
+        if(type == match_type::list) {
+            return fmt::format("{}domain listed in '{}'", include_type ? "list " : "", value);
+        }
+
+        // tests name the parts they look at themselves
+        if(type == match_type::expr) {
+            return fmt::format("{}{}", include_type ? "expression " : "", value);
+        }
+
         string r;
         if(include_type) {
-            r = is_regex ? "regex " : "substring ";
+            r = to_string(type) + " ";
         }
 
         r += fmt::format("'{}' in ", value);
@@ -130,18 +200,21 @@ namespace bt {
             parts.push_back(fmt::format("{}:app", ModeKey));
         }
 
-        if(is_regex) {
-            parts.push_back(fmt::format("{}:regex", TypeKey));
+        if(type == match_type::list) {
+            parts.push_back(fmt::format("{}:{}", TypeListKey, s));
+        } else {
+            if(type != match_type::substring) {
+                parts.push_back(fmt::format("{}:{}", TypeKey, to_string(type)));
+            }
+            parts.push_back(s);
         }
 
-        parts.push_back(s);
-
         return str::join_with_pipe(parts);
     }
 
     std::string match_rule::get_type_string() const {
         if(loc == match_location::lua_script) return strings::LuaScript;
-        return is_regex ? "regex" : "substring";
+        return to_string(type);
     }
 
     std::string match_rule::to_string(match_scope s) {
@@ -172,6 +245,23 @@ namespace bt {
         }
     }
 
+    std::string match_rule::to_string(match_type t) {
+        switch(t) {
+            case bt::match_type::regex:
+                return TypeRegexKey;
+            case bt::match_type::glob:
+                return TypeGlobKey;
+            case bt::match_type::list:
+                return TypeListKey;
+            case bt::match_type::expr:
+                return TypeExprKey;
+            case bt::match_type::exact:
+                return TypeExactKey;
+            default:
+                return "substring";
+        }
+    }
+
     match_scope match_rule::to_match_scope(const std::string& s) {
         if(s == "domain") return match_scope::domain;
         if(s == "path") return match_scope::path;
@@ -185,6 +275,15 @@ namespace bt {
         return match_location::url;
     }
 
+    match_type match_rule::to_match_type(const std::string& s) {
+        if(s == TypeRegexKey) return match_type::regex;
+        if(s == TypeGlobKey) return match_type::glob;
+        if(s == TypeListKey) return match_type::list;
+        if(s == TypeExprKey) return match_type::expr;
+        if(s == TypeExactKey) return match_type::exact;
+        return match_type::substring;
+    }
+
     bool match_rule::parse_url(const string& url, string& proto, string& host, string& path) {
         const string prot_end("://");
         proto = host = path = "";
@@ -212,75 +311,14 @@ namespace bt {
         return true;
     }
 
-    bool match_rule::contains(const string& input, const string& value) const {
-        if(is_regex) {
-            try {
-                regex r{value, regex_constants::icase};
-                return regex_match(input, r);
-            } catch(const std::regex_error& e) {
-                // most probably invalid regex pattern
-                return false;
-            }
-        } else {
-            return str::contains_ic(input, value);
-        }
-    }
-
     bool match_rule::is_match(const click_payload& up, const script_site& script) const {
-        if(loc == match_location::lua_script) {
-            return const_cast<script_site&>(script).call_rule(up, value);
-        }
-        return is_match(up);
+        auto ctx = matching::match_context::of(up, &script);
+        return matching::get_matcher(*this)(matching::rule_ref{matching::needle_of(*this), this}, ctx);
     }
 
     bool match_rule::is_match(const click_payload& up) const {
-
-        if(value.empty()) return false;
-
-        string src;
-        switch(loc) {
-            case match_location::url:
-                src = up.url;
-                break;
-            case match_location::window_title:
-                src = up.window_title;
-                break;
-            case match_location::process_name:
-                src = up.process_name;
-                break;
-        }
-        str::trim(src);
-
-        if(src.empty()) return false;
-
-        switch(loc) {
-            case bt::match_location::url: {
-                switch(scope) {
-                    case match_scope::any: {
-                        return contains(src, value);
-                    }
-                    case match_scope::domain: {
-                        string proto, host, path;
-                        if(!parse_url(src, proto, host, path)) return false;
-                        return contains(host, value);
-                    }
-                    case match_scope::path: {
-                        string proto, host, path, query;
-                        if(!parse_url(src, proto, host, path)) return false;
-                        return contains(path, value);
-                    }
-                }
-            }
-            break;
-            case bt::match_location::window_title:
-                return contains(src, value);
-            case bt::match_location::process_name:
-                return contains(src, value);
-            case bt::match_location::lua_script:
-                return false;
-        }
-
-        return false;
+        auto ctx = matching::match_context::of(up, nullptr);
+        return matching::get_matcher(*this)(matching::rule_ref{matching::needle_of(*this), this}, ctx);
     }
 
     bool match_rule::is_match(const string& url) const {
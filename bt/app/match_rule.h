@@ -1,8 +1,19 @@
 #pragma once
 
 #include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <regex>
 #include "script_site.h"
 #include "click_payload.h"
+#include "matching/linear_regex.h"
+#include "matching/glob.h"
+#include "matching/domain_list.h"
+
+namespace bt::matching {
+    class predicate_dag;
+}
 
 namespace bt {
     enum class match_scope : unsigned int {
@@ -11,6 +22,18 @@ namespace bt {
         path    = 2
     };
 
+    /**
+     * @brief How rule value is interpreted.
+     */
+    enum class match_type : unsigned int {
+        substring   = 0,
+        regex       = 1,
+        glob        = 2,
+        list        = 3,    // value is a path to a domain list file, matched against URL host
+        expr        = 4,    // value is a compound expression, see matching::predicate_dag
+        exact       = 5     // whole input equals the value, ignoring ASCII case
+    };
+
     enum class match_location : unsigned int {
         url             = 0,
         window_title    = 1,
@@ -22,6 +45,12 @@ namespace bt {
     public:
         explicit match_rule(const std::string& line);
 
+        /**
+         * @brief Prepares rule for matching (folds the needle, compiles regex). Called by the constructor, and must be
+         * called again after changing value or type.
+         */
+        void compile();
+
         bool is_match(const click_payload& up, const script_site& script) const;
         bool is_match(const click_payload& up) const;
         bool is_match(const std::string& url) const;
@@ -30,7 +59,7 @@ namespace bt {
         match_location loc{match_location::url};
         match_scope scope{match_scope::any};
         int priority{0};
-        bool is_regex{false};
+        match_type type{match_type::substring};
         bool app_mode{false};
         bool is_fallback{false};
 
@@ -43,20 +72,77 @@ namespace bt {
         // UI helpers
         bool ui_test_url_matches;
 
+        /**
+         * @brief Rules are the same if they look at the same thing in the same way, whatever their priority or mode.
+         */
         bool operator==(const match_rule& other) const;
 
+        /**
+         * @brief Key that identifies a rule for duplicate detection, consistent with operator==.
+         */
+        std::string get_identity() const;
+
         std::string to_string(bool include_type = true) const;
         std::string to_line() const;
         std::string get_type_string() const;
 
         static std::string to_string(match_scope s);
         static std::string to_string(match_location s);
+        static std::string to_string(match_type t);
         static match_scope to_match_scope(const std::string& s);
         static match_location to_match_location(const std::string& s);
+        static match_type to_match_type(const std::string& s);
 
         static bool parse_url(const std::string& url, std::string& proto, std::string& host, std::string& path);
 
+        // matching state prepared by compile()
+
+        bool is_ascii() const { return is_ascii_value; }
+        const std::string& get_folded_value() const { return folded_value; }
+
+        /**
+         * @brief Regex compiled for the linear time engine, or nullptr if the pattern uses syntax it doesn't support.
+         */
+        const std::shared_ptr<const matching::linear_regex>& get_linear_regex() const { return linear; }
+
+        /**
+         * @brief Fallback std::regex, only compiled when the linear time engine can't handle the pattern. nullptr if
+         * this is not a regex rule, the pattern is invalid, or get_linear_regex() should be used instead.
+         */
+        const std::regex* get_compiled_regex() const { return compiled_regex.get(); }
+
+        /**
+         * @brief Compiled wildcard pattern, or nullptr if this is not a glob rule.
+         */
+        const matching::glob* get_glob() const { return compiled_glob.get(); }
+
+        /**
+         * @brief Domain list, or nullptr if this is not a list rule or the list file can't be read.
+         */
+        const matching::domain_list* get_domain_list() const { return domain_list.get(); }
+
+        /**
+         * @brief Compound expression compiled on its own, or nullptr if this is not an expression rule or the
+         * expression is invalid. Its root is get_expression_root().
+         */
+        const matching::predicate_dag* get_expression() const { return expression.get(); }
+
+        std::uint32_t get_expression_root() const { return expression_root; }
+
+        /**
+         * @brief Folded literals any input must contain for the regex to match, see matching::regex_prefilter.
+         */
+        const std::vector<std::string>& get_required_literals() const { return required_literals; }
+
     private:
-        bool contains(const std::string& input, const std::string& value) const;
+        std::string folded_value;
+        bool is_ascii_value{true};
+        std::shared_ptr<const matching::linear_regex> linear;
+        std::shared_ptr<const std::regex> compiled_regex;
+        std::shared_ptr<const matching::glob> compiled_glob;
+        std::shared_ptr<const matching::domain_list> domain_list;
+        std::vector<std::string> required_literals;
+        std::shared_ptr<const matching::predicate_dag> expression;
+        std::uint32_t expression_root{0};
     };
 }
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "ci_search.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BT_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC allows AVX2 intrinsics anywhere, GCC and Clang need the function to be marked
+#if defined(BT_X86) && !defined(_MSC_VER)
+#define BT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define BT_TARGET_AVX2
+#endif
+
+using namespace std;
+
+namespace bt::matching {
+
+    static inline char fold(char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+    }
+
+    /**
+     * @brief Compares haystack at position with the folded needle.
+     */
+    static inline bool equals_folded(const char* h, const char* folded_needle, size_t n) {
+        for(size_t i = 0; i < n; i++) {
+            if(fold(h[i]) != folded_needle[i]) return false;
+        }
+        return true;
+    }
+
+    static inline unsigned int ctz(unsigned int mask) {
+#if defined(_MSC_VER)
+        unsigned long idx;
+        _BitScanForward(&idx, mask);
+        return idx;
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    void ci_search::fold_ascii(std::string& s) {
+        for(char& c : s) {
+            c = fold(c);
+        }
+    }
+
+    bool ci_search::is_ascii(std::string_view s) {
+        for(char c : s) {
+            if(static_cast<unsigned char>(c) >= 0x80) return false;
+        }
+        return true;
+    }
+
+    bool ci_search::equals(std::string_view s, std::string_view folded_needle) {
+        if(s.size() != folded_needle.size()) return false;
+        for(size_t i = 0; i < s.size(); i++) {
+            if(fold(s[i]) != folded_needle[i]) return false;
+        }
+        return true;
+    }
+
+    bool ci_search::contains_scalar(std::string_view haystack, std::string_view folded_needle) {
+        size_t n = folded_needle.size();
+        if(n == 0) return true;
+        if(n > haystack.size()) return false;
+
+        const char first = folded_needle[0];
+        const char* h = haystack.data();
+        size_t last = haystack.size() - n;
+        for(size_t i = 0; i <= last; i++) {
+            if(fold(h[i]) == first && equals_folded(h + i + 1, folded_needle.data() + 1, n - 1)) return true;
+        }
+        return false;
+    }
+
+#if defined(BT_X86)
+
+    // Both SIMD versions use the "first and last character" approach: compare folded blocks at offsets 0 and n - 1
+    // against broadcast first and last needle characters, and only verify the middle for positions where both match.
+    // Folding a block: bytes in 'A'..'Z' get 0x20 added. Bytes >= 0x80 compare as negative and are never touched.
+
+    static inline __m128i fold_sse2(__m128i x) {
+        const __m128i a = _mm_set1_epi8('A' - 1);
+        const __m128i z = _mm_set1_epi8('Z' + 1);
+        const __m128i bit = _mm_set1_epi8(0x20);
+        __m128i is_upper = _mm_and_si128(_mm_cmpgt_epi8(x, a), _mm_cmplt_epi8(x, z));
+        return _mm_or_si128(x, _mm_and_si128(is_upper, bit));
+    }
+
+    bool ci_search::contains_sse2(std::string_view haystack, std::string_view folded_needle) {
+        size_t n = folded_needle.size();
+        if(n == 0) return true;
+        if(n > haystack.size()) return false;
+
+        const char* h = haystack.data();
+        const __m128i first = _mm_set1_epi8(folded_needle[0]);
+        const __m128i last = _mm_set1_epi8(folded_needle[n - 1]);
+
+        // positions i such that a full 16-byte block can be loaded at i + n - 1
+        size_t count = haystack.size() - n + 1;
+        size_t i = 0;
+        for(; i + 16 <= count; i += 16) {
+            __m128i block_first = fold_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i)));
+            __m128i block_last = fold_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i + n - 1)));
+            unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last))));
+
+            while(mask) {
+                unsigned int bit = ctz(mask);
+                if(n <= 2 || equals_folded(h + i + bit + 1, folded_needle.data() + 1, n - 2)) return true;
+                mask &= mask - 1;
+            }
+        }
+
+        // tail
+        return contains_scalar(haystack.substr(i), folded_needle);
+    }
+
+    BT_TARGET_AVX2
+    static inline __m256i fold_avx2(__m256i x) {
+        const __m256i a = _mm256_set1_epi8('A' - 1);
+        const __m256i z = _mm256_set1_epi8('Z' + 1);
+        const __m256i bit = _mm256_set1_epi8(0x20);
+        __m256i is_upper = _mm256_and_si256(_mm256_cmpgt_epi8(x, a), _mm256_cmpgt_epi8(z, x));
+        return _mm256_or_si256(x, _mm256_and_si256(is_upper, bit));
+    }
+
+    BT_TARGET_AVX2
+    bool ci_search::contains_avx2(std::string_view haystack, std::string_view folded_needle) {
+        size_t n = folded_needle.size();
+        if(n == 0) return true;
+        if(n > haystack.size()) return false;
+
+        const char* h = haystack.data();
+        const __m256i first = _mm256_set1_epi8(folded_needle[0]);
+        const __m256i last = _mm256_set1_epi8(folded_needle[n - 1]);
+
+        size_t count = haystack.size() - n + 1;
+        size_t i = 0;
+        for(; i + 32 <= count; i += 32) {
+            __m256i block_first = fold_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(h + i)));
+            __m256i block_last = fold_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(h + i + n - 1)));
+            unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last))));
+
+            while(mask) {
+                unsigned int bit = ctz(mask);
+                if(n <= 2 || equals_folded(h + i + bit + 1, folded_needle.data() + 1, n - 2)) return true;
+                mask &= mask - 1;
+            }
+        }
+
+        // finish with SSE2 which handles its own scalar tail
+        return contains_sse2(haystack.substr(i), folded_needle);
+    }
+
+    bool ci_search::has_sse2() {
+#if defined(_M_X64) || defined(__x86_64__)
+        return true;    // part of x64 baseline
+#elif defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[3] & (1 << 26)) != 0;
+#else
+        return __builtin_cpu_supports("sse2");
+#endif
+    }
+
+    bool ci_search::has_avx2() {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if(info[0] < 7) return false;
+
+        // OS must save YMM registers (OSXSAVE + XCR0 bits 1 and 2)
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if(!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+#else
+
+    bool ci_search::contains_sse2(std::string_view haystack, std::string_view folded_needle) {
+        return contains_scalar(haystack, folded_needle);
+    }
+
+    bool ci_search::contains_avx2(std::string_view haystack, std::string_view folded_needle) {
+        return contains_scalar(haystack, folded_needle);
+    }
+
+    bool ci_search::has_sse2() { return false; }
+
+    bool ci_search::has_avx2() { return false; }
+
+#endif
+
+    ci_search::contains_fn ci_search::get_impl() {
+        static const contains_fn impl = []() -> contains_fn {
+            if(has_avx2()) return &contains_avx2;
+            if(has_sse2()) return &contains_sse2;
+            return &contains_scalar;
+        }();
+        return impl;
+    }
+
+    bool ci_search::contains(std::string_view haystack, std::string_view folded_needle) {
+        return get_impl()(haystack, folded_needle);
+    }
+
+    const char* ci_search::get_impl_name() {
+        contains_fn impl = get_impl();
+        if(impl == &contains_avx2) return "avx2";
+        if(impl == &contains_sse2) return "sse2";
+        return "scalar";
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+namespace bt::matching {
+
+    /**
+     * @brief ASCII case-insensitive substring search. Needles are expected to be folded in advance with fold_ascii,
+     * the haystack is folded on the fly. Picks the best implementation for the current CPU (AVX2, SSE2 or scalar) on first use.
+     */
+    class ci_search {
+    public:
+
+        /**
+         * @brief Lowercases ASCII letters in place, leaves everything else untouched.
+         */
+        static void fold_ascii(std::string& s);
+
+        /**
+         * @brief Whether the string only contains 7-bit ASCII characters, in which case ASCII folding is equivalent to full case folding.
+         */
+        static bool is_ascii(std::string_view s);
+
+        /**
+         * @brief Searches for an already folded needle.
+         * @param haystack any string, does not need to be folded
+         * @param folded_needle needle folded with fold_ascii
+         * @return true if needle is found or is empty
+         */
+        static bool contains(std::string_view haystack, std::string_view folded_needle);
+
+        /**
+         * @brief Whether the whole string equals an already folded needle.
+         * @param s any string, does not need to be folded
+         */
+        static bool equals(std::string_view s, std::string_view folded_needle);
+
+        /**
+         * @brief Name of the implementation selected for this CPU, for diagnostics and benchmarks.
+         */
+        static const char* get_impl_name();
+
+        // individual implementations are exposed for testing and benchmarking
+        static bool contains_scalar(std::string_view haystack, std::string_view folded_needle);
+        static bool contains_sse2(std::string_view haystack, std::string_view folded_needle);
+        static bool contains_avx2(std::string_view haystack, std::string_view folded_needle);
+
+        static bool has_sse2();
+        static bool has_avx2();
+
+    private:
+        using contains_fn = bool (*)(std::string_view, std::string_view);
+
+        /**
+         * @brief Selected implementation. Function-local static, so it's safe to use during static initialisation.
+         */
+        static contains_fn get_impl();
+    };
+}
@@ -0,0 +1,248 @@
+#include "domain_list.h"
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include <cstring>
+#include <fmt/core.h>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace bt::matching {
+
+    const char Magic[4] = {'B', 'T', 'D', 'L'};
+    const string TableExtension = ".btdl";
+
+    static inline char fold(char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+    }
+
+    struct registry {
+        mutex m;
+        fs::path base_dir;
+        fs::path cache_dir;
+
+        struct entry {
+            string table_path;
+            weak_ptr<const domain_list> list;
+        };
+        map<string, entry> lists;
+    };
+
+    // function-local, as rules can be compiled during static initialisation of the global config
+    static registry& get_registry() {
+        static registry r;
+        return r;
+    }
+
+    /**
+     * @brief Normalises a source line to a bare lowercase domain, or returns an empty string.
+     */
+    static string normalise(string line) {
+        size_t comment = line.find('#');
+        if(comment != string::npos) line.resize(comment);
+
+        // hosts file style, "0.0.0.0 domain"
+        size_t end = line.find_last_not_of(" \t\r\n");
+        if(end == string::npos) return "";
+        size_t start = line.find_last_of(" \t", end);
+        start = start == string::npos ? 0 : start + 1;
+        string d = line.substr(start, end - start + 1);
+
+        if(d.starts_with("*.")) d.erase(0, 2);
+        while(d.starts_with(".")) d.erase(0, 1);
+        while(d.ends_with(".")) d.pop_back();
+        for(char& c : d) c = fold(c);
+        return d;
+    }
+
+    void domain_list::configure(const std::string& base_dir, const std::string& cache_dir) {
+        registry& r = get_registry();
+        lock_guard<mutex> lock{r.m};
+        r.base_dir = base_dir;
+        r.cache_dir = cache_dir;
+    }
+
+    std::shared_ptr<const domain_list> domain_list::get(const std::string& path) {
+        registry& r = get_registry();
+        lock_guard<mutex> lock{r.m};
+
+        error_code ec;
+        fs::path source{path};
+        if(source.is_relative() && !r.base_dir.empty()) source = r.base_dir / source;
+        source = fs::absolute(source, ec).lexically_normal();
+
+        auto size = fs::file_size(source, ec);
+        if(ec) return nullptr;
+        auto mtime = fs::last_write_time(source, ec).time_since_epoch().count();
+        if(ec) return nullptr;
+
+        // table name changes with the source, so a table mapped elsewhere never needs to be overwritten
+        fs::path cache_dir = r.cache_dir.empty() ? source.parent_path() : r.cache_dir;
+        string prefix = fmt::format("{:016x}", std::hash<string>{}(source.string()));
+        fs::path table = cache_dir / fmt::format("{}.{:x}.{:x}{}", prefix, size, mtime, TableExtension);
+
+        string key = source.string();
+        auto it = r.lists.find(key);
+        if(it != r.lists.end() && it->second.table_path == table.string()) {
+            if(auto existing = it->second.list.lock()) return existing;
+        }
+
+        auto list = open(table.string());
+        if(!list) {
+            fs::create_directories(cache_dir, ec);
+
+            // another instance may have compiled it meanwhile, in which case the rename fails but the table is there
+            compile(source.string(), table.string());
+            list = open(table.string());
+            if(!list) return nullptr;
+
+            // tables of previous versions of this source, fails harmlessly for ones still mapped
+            for(const auto& de : fs::directory_iterator(cache_dir, ec)) {
+                string name = de.path().filename().string();
+                if(name.starts_with(prefix) && name.ends_with(TableExtension) && de.path() != table) {
+                    fs::remove(de.path(), ec);
+                }
+            }
+        }
+
+        r.lists[key] = registry::entry{table.string(), list};
+        return list;
+    }
+
+    bool domain_list::compile(const std::string& source_path, const std::string& table_path) {
+        ifstream in{source_path};
+        if(!in.is_open()) return false;
+
+        vector<string> domains;
+        string line;
+        while(getline(in, line)) {
+            string d = normalise(line);
+            if(!d.empty()) domains.push_back(std::move(d));
+        }
+        sort(domains.begin(), domains.end());
+        domains.erase(unique(domains.begin(), domains.end()), domains.end());
+
+        // at most half full, so probe sequences stay short
+        uint32_t bucket_count{16};
+        while(bucket_count < domains.size() * 2) bucket_count *= 2;
+
+        vector<bucket> table(bucket_count);
+        uint64_t offset = sizeof(header) + sizeof(bucket) * bucket_count;
+        for(const string& d : domains) {
+            uint64_t h = hash(d);
+            uint32_t i = static_cast<uint32_t>(h) & (bucket_count - 1);
+            while(table[i].length != 0) i = (i + 1) & (bucket_count - 1);
+            table[i] = bucket{h, static_cast<uint32_t>(offset), static_cast<uint32_t>(d.size())};
+            offset += d.size();
+            if(offset > UINT32_MAX) return false;
+        }
+
+        header hdr{};
+        memcpy(hdr.magic, Magic, sizeof(Magic));
+        hdr.version = Version;
+        hdr.count = static_cast<uint32_t>(domains.size());
+        hdr.bucket_count = bucket_count;
+
+        // write to a temporary file and rename, so that a table is never seen half-written
+        string tmp_path = table_path + ".tmp";
+        {
+            ofstream out{tmp_path, ios::binary | ios::trunc};
+            if(!out.is_open()) return false;
+            out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+            out.write(reinterpret_cast<const char*>(table.data()), sizeof(bucket) * table.size());
+            for(const string& d : domains) {
+                out.write(d.data(), d.size());
+            }
+            if(!out.good()) return false;
+        }
+
+        error_code ec;
+        fs::rename(tmp_path, table_path, ec);
+        if(ec) {
+            fs::remove(tmp_path, ec);
+            return false;
+        }
+        return true;
+    }
+
+    std::shared_ptr<const domain_list> domain_list::open(const std::string& table_path) {
+        shared_ptr<domain_list> r{new domain_list()};
+        if(!r->file.open(table_path)) return nullptr;
+
+        const char* data = r->file.data();
+        size_t size = r->file.size();
+        if(size < sizeof(header)) return nullptr;
+
+        header hdr;
+        memcpy(&hdr, data, sizeof(hdr));
+        if(memcmp(hdr.magic, Magic, sizeof(Magic)) != 0 || hdr.version != Version) return nullptr;
+        if(hdr.bucket_count == 0 || (hdr.bucket_count & (hdr.bucket_count - 1)) != 0) return nullptr;
+        if(size < sizeof(header) + sizeof(bucket) * static_cast<uint64_t>(hdr.bucket_count)) return nullptr;
+
+        // mapping is page aligned and the header keeps buckets 8 byte aligned
+        r->buckets = reinterpret_cast<const bucket*>(data + sizeof(header));
+        bool has_empty{false};
+        for(uint32_t i = 0; i < hdr.bucket_count; i++) {
+            const bucket& b = r->buckets[i];
+            if(b.length == 0) {
+                has_empty = true;
+            } else if(static_cast<uint64_t>(b.offset) + b.length > size) {
+                return nullptr;
+            }
+        }
+
+        // lookups stop at an empty bucket
+        if(!has_empty) return nullptr;
+
+        r->table_path = table_path;
+        r->count = hdr.count;
+        r->mask = hdr.bucket_count - 1;
+        return r;
+    }
+
+    bool domain_list::contains_host(std::string_view host) const {
+        size_t at = host.rfind('@');
+        if(at != string_view::npos) host = host.substr(at + 1);
+        host = host.substr(0, host.find(':'));
+        while(host.ends_with('.')) host.remove_suffix(1);
+
+        // the host itself, then every parent domain
+        while(!host.empty()) {
+            if(contains_domain(host)) return true;
+            size_t dot = host.find('.');
+            if(dot == string_view::npos) break;
+            host.remove_prefix(dot + 1);
+        }
+        return false;
+    }
+
+    bool domain_list::contains_domain(std::string_view domain) const {
+        uint64_t h = hash(domain);
+        for(uint32_t i = static_cast<uint32_t>(h) & mask;; i = (i + 1) & mask) {
+            const bucket& b = buckets[i];
+            if(b.length == 0) return false;
+            if(b.hash != h || b.length != domain.size()) continue;
+
+            const char* s = file.data() + b.offset;
+            bool eq{true};
+            for(size_t j = 0; j < domain.size() && eq; j++) {
+                eq = fold(domain[j]) == s[j];
+            }
+            if(eq) return true;
+        }
+    }
+
+    std::uint64_t domain_list::hash(std::string_view s) {
+        // FNV-1a over folded characters, so lookups don't need a lowercase copy of the host
+        uint64_t h{14695981039346656037ull};
+        for(char c : s) {
+            h ^= static_cast<unsigned char>(fold(c));
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstdint>
+#include "../mapped_file.h"
+
+namespace bt::matching {
+
+    /**
+     * @brief Large list of domains kept outside of the configuration, for "list:path" rules.
+     *
+     * The source is a text file with one domain per line ("#" starts a comment, "*." and "." prefixes are ignored,
+     * and for hosts file style lines only the last word is used). It is compiled into a binary open addressing hash
+     * table, which is memory-mapped, so lookups don't need the list to be loaded or parsed. A host matches if it or any
+     * of its parent domains is listed, which takes one lookup per label.
+     *
+     * Compiled tables are named after the source path and its size and modification time, so a list is only compiled
+     * again when the source changes.
+     */
+    class domain_list {
+    public:
+        static constexpr std::uint32_t Version = 1;
+
+        /**
+         * @brief Sets where relative list paths are resolved from and where compiled tables are kept.
+         */
+        static void configure(const std::string& base_dir, const std::string& cache_dir);
+
+        /**
+         * @brief Shared list for the source file, compiling it first if needed.
+         * @return nullptr if the source can't be read
+         */
+        static std::shared_ptr<const domain_list> get(const std::string& path);
+
+        /**
+         * @brief Compiles source list into a binary table.
+         */
+        static bool compile(const std::string& source_path, const std::string& table_path);
+
+        /**
+         * @brief Maps a compiled table.
+         * @return nullptr if the file is missing or not a valid table
+         */
+        static std::shared_ptr<const domain_list> open(const std::string& table_path);
+
+        /**
+         * @brief Whether the host or any of its parent domains is in the list. Port, user info and case are ignored.
+         */
+        bool contains_host(std::string_view host) const;
+
+        size_t size() const { return count; }
+
+        /**
+         * @brief Compiled table this list was mapped from. Its name changes when the source does.
+         */
+        const std::string& get_table_path() const { return table_path; }
+
+    private:
+        struct header {
+            char magic[4];
+            std::uint32_t version;
+            std::uint32_t count;
+            std::uint32_t bucket_count;     // power of 2
+        };
+
+        struct bucket {
+            std::uint64_t hash;
+            std::uint32_t offset;           // of the domain in the file
+            std::uint32_t length;           // 0 for empty buckets
+        };
+
+        mapped_file file;
+        std::string table_path;
+        std::uint32_t count{0};
+        std::uint32_t mask{0};
+        const bucket* buckets{nullptr};
+
+        bool contains_domain(std::string_view domain) const;
+
+        static std::uint64_t hash(std::string_view s);
+    };
+}
@@ -0,0 +1,108 @@
+#include "glob.h"
+#include "ci_search.h"
+
+using namespace std;
+
+namespace bt::matching {
+
+    static inline char fold(char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+    }
+
+    static inline bool is_label_char(char c) {
+        return c != '.' && c != '/';
+    }
+
+    glob::glob(std::string_view pattern) {
+        string run;
+        auto end_run = [this, &run]() {
+            if(run.size() > required.size()) required = run;
+            run.clear();
+        };
+
+        for(size_t i = 0; i < pattern.size(); i++) {
+            char c = pattern[i];
+            if(c == '*') {
+                end_run();
+                if(pattern.substr(i).starts_with("**.")) {
+                    tokens.push_back(token{token::kind::labels});
+                    i += 2;
+                } else if(tokens.empty() || tokens.back().k != token::kind::star) {
+                    // consecutive stars are the same as one
+                    tokens.push_back(token{token::kind::star});
+                }
+            } else if(c == '?') {
+                end_run();
+                tokens.push_back(token{token::kind::any});
+            } else {
+                c = fold(c);
+                run += c;
+                tokens.push_back(token{token::kind::literal, c});
+            }
+        }
+        end_run();
+    }
+
+    void glob::add_closure(const std::vector<token>& tokens, std::vector<char>& states) {
+        // star and labels can match nothing, states only ever move forward so one pass is enough
+        for(size_t i = 0; i < tokens.size(); i++) {
+            if(states[i] && (tokens[i].k == token::kind::star || tokens[i].k == token::kind::labels)) {
+                states[i + 1] = 1;
+            }
+        }
+    }
+
+    bool glob::match(std::string_view input) const {
+        if(!required.empty() && !ci_search::contains(input, required)) return false;
+
+        // states[i]: first i tokens matched. in_label[i]: inside a label of the labels token i
+        size_t n = tokens.size();
+        vector<char> states(n + 1), next(n + 1);
+        vector<char> in_label(n), next_in_label(n);
+        states[0] = 1;
+        add_closure(tokens, states);
+
+        for(char c : input) {
+            fill(next.begin(), next.end(), 0);
+            fill(next_in_label.begin(), next_in_label.end(), 0);
+            char fc = fold(c);
+            bool alive{false};
+
+            for(size_t i = 0; i < n; i++) {
+                const token& t = tokens[i];
+                if(states[i]) {
+                    switch(t.k) {
+                        case token::kind::literal:
+                            if(fc == t.c) next[i + 1] = 1;
+                            break;
+                        case token::kind::any:
+                            next[i + 1] = 1;
+                            break;
+                        case token::kind::star:
+                            next[i] = 1;
+                            break;
+                        case token::kind::labels:
+                            if(is_label_char(c)) next_in_label[i] = 1;
+                            break;
+                    }
+                }
+                if(in_label[i]) {
+                    if(is_label_char(c)) {
+                        next_in_label[i] = 1;
+                    } else if(c == '.') {
+                        // label complete, another one may follow
+                        next[i] = 1;
+                    }
+                }
+                alive = alive || next[i + 1] || next[i] || next_in_label[i];
+            }
+
+            if(!alive) return false;
+            states.swap(next);
+            in_label.swap(next_in_label);
+            add_closure(tokens, states);
+        }
+
+        return states[n];
+    }
+}
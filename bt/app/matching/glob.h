@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bt::matching {
+
+    /**
+     * @brief Wildcard pattern matched against the whole input, ASCII case-insensitive:
+     * - "*" matches any sequence of characters, including an empty one
+     * - "?" matches any single character
+     * - "**." matches any number of host name labels, each followed by a dot, so "**.example.com" matches
+     *   "example.com" and "a.b.example.com", but never crosses a "/"
+     *
+     * Compiled into a list of tokens and matched by tracking all positions in the pattern at once, so matching time is
+     * linear in input length, without backtracking.
+     */
+    class glob {
+    public:
+        explicit glob(std::string_view pattern);
+
+        bool match(std::string_view input) const;
+
+    private:
+        struct token {
+            enum class kind {
+                literal,    // folded character
+                any,        // ?
+                star,       // *
+                labels      // **.
+            };
+
+            kind k;
+            char c{0};
+        };
+
+        std::vector<token> tokens;
+
+        /**
+         * @brief Longest literal run in the pattern, folded. Input lacking it can't match.
+         */
+        std::string required;
+
+        static void add_closure(const std::vector<token>& tokens, std::vector<char>& states);
+    };
+}
@@ -0,0 +1,510 @@
+#include "linear_regex.h"
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+
+namespace bt::matching {
+
+    const uint32_t Unbounded = UINT32_MAX;
+
+    // counted repetitions and nesting beyond these are left to std::regex
+    const uint32_t MaxRepeat = 1000;
+    const int MaxDepth = 64;
+
+    /**
+     * @brief Parses a pattern into a syntax tree, then builds NFA states for it in the owning regex.
+     */
+    class linear_regex::parser {
+    public:
+        parser(string_view p, bool icase, linear_regex& re) : p{p}, icase{icase}, re{re} {}
+
+        /**
+         * @brief Adds pattern to the NFA.
+         * @return entry state, or None if the pattern is not supported
+         */
+        uint32_t add(uint32_t pattern) {
+            node root;
+            if(!parse_alt(root, 0) || pos != p.size()) return None;
+
+            uint32_t accept = re.add_state(nfa_state::kind::accept, pattern, None);
+            uint32_t entry = build(root, accept);
+            return re.states.size() > MaxStates ? None : entry;
+        }
+
+    private:
+        struct node {
+            enum class type {
+                empty,
+                set,
+                concat,
+                alt,
+                repeat
+            };
+
+            type t{type::empty};
+            uint32_t set{0};
+            vector<node> children;
+            uint32_t min{0};
+            uint32_t max{0};
+        };
+
+        string_view p;
+        bool icase;
+        linear_regex& re;
+        size_t pos{0};
+
+        bool at(char c) const { return pos < p.size() && p[pos] == c; }
+
+        node make_set(bitset<256> s) {
+            if(icase) {
+                for(int c = 'a'; c <= 'z'; c++) {
+                    int uc = c - 'a' + 'A';
+                    if(s[c] || s[uc]) {
+                        s.set(c);
+                        s.set(uc);
+                    }
+                }
+            }
+
+            node n;
+            n.t = node::type::set;
+            n.set = static_cast<uint32_t>(re.sets.size());
+            re.sets.push_back(s);
+            return n;
+        }
+
+        static bitset<256> range(int from, int to) {
+            bitset<256> s;
+            for(int c = from; c <= to; c++) s.set(c);
+            return s;
+        }
+
+        static bitset<256> word() {
+            return range('a', 'z') | range('A', 'Z') | range('0', '9') | range('_', '_');
+        }
+
+        static bitset<256> space() {
+            return range(' ', ' ') | range('\t', '\r');
+        }
+
+        static int hex(char c) {
+            if(c >= '0' && c <= '9') return c - '0';
+            if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        }
+
+        /**
+         * @brief Parses escape sequence after the backslash.
+         * @param ch set to the character for single character escapes, or -1 for class escapes (\d etc.)
+         */
+        bool parse_escape(bitset<256>& s, int& ch) {
+            if(pos >= p.size()) return false;
+            char e = p[pos++];
+            ch = -1;
+            switch(e) {
+                case 'd': s = range('0', '9'); return true;
+                case 'D': s = ~range('0', '9'); return true;
+                case 'w': s = word(); return true;
+                case 'W': s = ~word(); return true;
+                case 's': s = space(); return true;
+                case 'S': s = ~space(); return true;
+                case 'n': ch = '\n'; break;
+                case 't': ch = '\t'; break;
+                case 'r': ch = '\r'; break;
+                case 'f': ch = '\f'; break;
+                case 'v': ch = '\v'; break;
+                case '0':
+                    // octal escapes are not ECMAScript
+                    if(pos < p.size() && p[pos] >= '0' && p[pos] <= '9') return false;
+                    ch = 0;
+                    break;
+                case 'x': {
+                    if(pos + 2 > p.size()) return false;
+                    int hi = hex(p[pos]), lo = hex(p[pos + 1]);
+                    if(hi < 0 || lo < 0) return false;
+                    ch = hi * 16 + lo;
+                    pos += 2;
+                    break;
+                }
+                default:
+                    // escaped punctuation is literal, letters and digits are back references, assertions, etc.
+                    if(isalnum(static_cast<unsigned char>(e))) return false;
+                    ch = static_cast<unsigned char>(e);
+                    break;
+            }
+            s.reset();
+            s.set(ch);
+            return true;
+        }
+
+        bool parse_class_atom(bitset<256>& s, int& ch) {
+            if(pos >= p.size()) return false;
+            char c = p[pos++];
+            if(c == '\\') return parse_escape(s, ch);
+
+            // POSIX classes like [[:alpha:]]
+            if(c == '[' && pos < p.size() && (p[pos] == ':' || p[pos] == '.' || p[pos] == '=')) return false;
+
+            ch = static_cast<unsigned char>(c);
+            s.reset();
+            s.set(ch);
+            return true;
+        }
+
+        bool parse_class(node& out) {
+            pos++;  // [
+            bool negate = at('^');
+            if(negate) pos++;
+
+            // [] and [^] are treated differently by regex flavours, let std::regex deal with them
+            if(at(']')) return false;
+
+            bitset<256> s;
+            while(pos < p.size() && p[pos] != ']') {
+                bitset<256> lo_s;
+                int lo;
+                if(!parse_class_atom(lo_s, lo)) return false;
+
+                if(at('-') && pos + 1 < p.size() && p[pos + 1] != ']') {
+                    pos++;
+                    bitset<256> hi_s;
+                    int hi;
+                    if(!parse_class_atom(hi_s, hi)) return false;
+                    if(lo < 0 || hi < 0 || lo > hi) return false;
+                    s |= range(lo, hi);
+                } else {
+                    s |= lo_s;
+                }
+            }
+            if(!at(']')) return false;
+            pos++;
+
+            // fold before negating, so that [^a] excludes "A" too
+            out = make_set(s);
+            if(negate) {
+                re.sets[out.set].flip();
+            }
+            return true;
+        }
+
+        bool parse_atom(node& out, int depth) {
+            char c = p[pos];
+            switch(c) {
+                case '(': {
+                    pos++;
+                    if(at('?')) {
+                        // only non-capturing groups, not lookarounds
+                        if(pos + 1 >= p.size() || p[pos + 1] != ':') return false;
+                        pos += 2;
+                    }
+                    if(depth + 1 > MaxDepth) return false;
+                    if(!parse_alt(out, depth + 1)) return false;
+                    if(!at(')')) return false;
+                    pos++;
+                    return true;
+                }
+                case '[':
+                    return parse_class(out);
+                case '.':
+                    pos++;
+                    out = make_set(~(range('\n', '\n') | range('\r', '\r')));
+                    return true;
+                case '\\': {
+                    pos++;
+                    bitset<256> s;
+                    int ch;
+                    if(!parse_escape(s, ch)) return false;
+                    out = make_set(s);
+                    return true;
+                }
+                case '^':
+                case '$':
+                case '*':
+                case '+':
+                case '?':
+                case '{':
+                case '}':
+                case ']':
+                    return false;
+                default: {
+                    pos++;
+                    bitset<256> s;
+                    s.set(static_cast<unsigned char>(c));
+                    out = make_set(s);
+                    return true;
+                }
+            }
+        }
+
+        bool parse_number(uint32_t& n) {
+            size_t start = pos;
+            n = 0;
+            while(pos < p.size() && p[pos] >= '0' && p[pos] <= '9') {
+                n = n * 10 + (p[pos++] - '0');
+                if(n > MaxRepeat) return false;
+            }
+            return pos > start;
+        }
+
+        bool parse_quantifier(node& atom) {
+            if(pos >= p.size()) return true;
+
+            uint32_t min, max;
+            switch(p[pos]) {
+                case '*':
+                    min = 0;
+                    max = Unbounded;
+                    pos++;
+                    break;
+                case '+':
+                    min = 1;
+                    max = Unbounded;
+                    pos++;
+                    break;
+                case '?':
+                    min = 0;
+                    max = 1;
+                    pos++;
+                    break;
+                case '{':
+                    pos++;
+                    if(!parse_number(min)) return false;
+                    max = min;
+                    if(at(',')) {
+                        pos++;
+                        max = Unbounded;
+                        if(!at('}') && (!parse_number(max) || max < min)) return false;
+                    }
+                    if(!at('}')) return false;
+                    pos++;
+                    break;
+                default:
+                    return true;
+            }
+
+            // laziness doesn't change whether the whole input matches
+            if(at('?')) pos++;
+
+            // a** and friends are errors in ECMAScript
+            if(at('*') || at('+') || at('?') || at('{')) return false;
+
+            node r;
+            r.t = node::type::repeat;
+            r.min = min;
+            r.max = max;
+            r.children.push_back(std::move(atom));
+            atom = std::move(r);
+            return true;
+        }
+
+        bool parse_seq(node& out, int depth) {
+            out = node{};
+            out.t = node::type::concat;
+
+            // anchors are implied by full match, but only allowed where they are no-ops
+            if(depth == 0 && at('^')) pos++;
+
+            while(pos < p.size() && p[pos] != '|' && p[pos] != ')') {
+                if(p[pos] == '$') {
+                    if(depth == 0 && (pos + 1 == p.size() || p[pos + 1] == '|')) {
+                        pos++;
+                        continue;
+                    }
+                    return false;
+                }
+
+                node atom;
+                if(!parse_atom(atom, depth) || !parse_quantifier(atom)) return false;
+                out.children.push_back(std::move(atom));
+            }
+
+            return true;
+        }
+
+        bool parse_alt(node& out, int depth) {
+            out = node{};
+            out.t = node::type::alt;
+
+            while(true) {
+                node seq;
+                if(!parse_seq(seq, depth)) return false;
+                out.children.push_back(std::move(seq));
+                if(!at('|')) break;
+                pos++;
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief Builds states for the node, continuing to next. Built back to front, so nothing needs patching.
+         */
+        uint32_t build(const node& n, uint32_t next) {
+            if(re.states.size() > MaxStates) return next;
+
+            switch(n.t) {
+                case node::type::set:
+                    return re.add_state(nfa_state::kind::consume, n.set, next);
+                case node::type::concat:
+                    for(auto it = n.children.rbegin(); it != n.children.rend(); ++it) {
+                        next = build(*it, next);
+                    }
+                    return next;
+                case node::type::alt: {
+                    uint32_t r = build(n.children.back(), next);
+                    for(size_t i = n.children.size() - 1; i > 0; i--) {
+                        r = re.add_state(nfa_state::kind::split, 0, build(n.children[i - 1], next), r);
+                    }
+                    return r;
+                }
+                case node::type::repeat: {
+                    const node& child = n.children[0];
+                    uint32_t tail = next;
+                    if(n.max == Unbounded) {
+                        uint32_t loop = re.add_state(nfa_state::kind::split, 0, None, next);
+                        uint32_t body = build(child, loop);
+                        re.states[loop].out = body;
+                        tail = loop;
+                    } else {
+                        // x{0,2} is (x(x)?)?
+                        for(uint32_t i = n.min; i < n.max; i++) {
+                            tail = re.add_state(nfa_state::kind::split, 0, build(child, tail), next);
+                        }
+                    }
+                    for(uint32_t i = 0; i < n.min; i++) {
+                        tail = build(child, tail);
+                    }
+                    return tail;
+                }
+                default:
+                    return next;
+            }
+        }
+    };
+
+    std::shared_ptr<const linear_regex> linear_regex::compile(const std::vector<std::string>& patterns, bool icase) {
+        shared_ptr<linear_regex> re{new linear_regex()};
+
+        for(size_t i = 0; i < patterns.size(); i++) {
+            parser ps{patterns[i], icase, *re};
+            uint32_t entry = ps.add(static_cast<uint32_t>(i));
+            if(entry == None) return nullptr;
+            re->start = re->start == None ? entry : re->add_state(nfa_state::kind::split, 0, entry, re->start);
+        }
+        re->patterns = patterns.size();
+
+        return re;
+    }
+
+    std::shared_ptr<const linear_regex> linear_regex::compile(std::string_view pattern, bool icase) {
+        return compile(vector<string>{string{pattern}}, icase);
+    }
+
+    bool linear_regex::is_supported(std::string_view pattern) {
+        return compile(pattern) != nullptr;
+    }
+
+    std::uint32_t linear_regex::add_state(nfa_state::kind k, std::uint32_t arg, std::uint32_t out, std::uint32_t out1) {
+        states.push_back(nfa_state{k, arg, out, out1});
+        return static_cast<uint32_t>(states.size() - 1);
+    }
+
+    void linear_regex::add_closure(std::uint32_t s, std::vector<std::uint32_t>& set, std::vector<bool>& seen) const {
+        vector<uint32_t> stack{s};
+        while(!stack.empty()) {
+            uint32_t x = stack.back();
+            stack.pop_back();
+            if(x == None || seen[x]) continue;
+            seen[x] = true;
+
+            const nfa_state& st = states[x];
+            if(st.k == nfa_state::kind::split) {
+                stack.push_back(st.out1);
+                stack.push_back(st.out);
+            } else {
+                set.push_back(x);
+            }
+        }
+    }
+
+    std::int32_t linear_regex::get_dfa_state(std::vector<std::uint32_t>& nfa_set, bool& flushed) const {
+        sort(nfa_set.begin(), nfa_set.end());
+        string key{reinterpret_cast<const char*>(nfa_set.data()), nfa_set.size() * sizeof(uint32_t)};
+
+        auto it = dfa_ids.find(key);
+        if(it != dfa_ids.end()) return it->second;
+
+        if(dfa.size() >= MaxCachedStates) {
+            dfa.clear();
+            dfa_ids.clear();
+            dfa_start = Unknown;
+            flushed = true;
+        }
+
+        auto st = make_unique<dfa_state>();
+        for(uint32_t s : nfa_set) {
+            if(states[s].k == nfa_state::kind::accept) st->accepts.push_back(states[s].arg);
+        }
+        st->nfa = std::move(nfa_set);
+        st->next.fill(Unknown);
+
+        int32_t id = static_cast<int32_t>(dfa.size());
+        dfa.push_back(std::move(st));
+        dfa_ids.emplace(std::move(key), id);
+        return id;
+    }
+
+    std::int32_t linear_regex::step(std::int32_t from, std::uint8_t b) const {
+        int32_t cached = dfa[from]->next[b];
+        if(cached != Unknown) return cached;
+
+        vector<uint32_t> set;
+        vector<bool> seen(states.size());
+        for(uint32_t s : dfa[from]->nfa) {
+            const nfa_state& st = states[s];
+            if(st.k == nfa_state::kind::consume && sets[st.arg][b]) {
+                add_closure(st.out, set, seen);
+            }
+        }
+
+        bool flushed{false};
+        int32_t id = get_dfa_state(set, flushed);
+        if(!flushed) dfa[from]->next[b] = id;
+        return id;
+    }
+
+    const linear_regex::dfa_state& linear_regex::run(std::string_view input) const {
+        if(dfa_start == Unknown) {
+            vector<uint32_t> set;
+            vector<bool> seen(states.size());
+            add_closure(start, set, seen);
+            bool flushed{false};
+            dfa_start = get_dfa_state(set, flushed);
+        }
+
+        int32_t s = dfa_start;
+        for(char c : input) {
+            s = step(s, static_cast<uint8_t>(c));
+
+            // nothing can match anymore
+            if(dfa[s]->nfa.empty()) break;
+        }
+        return *dfa[s];
+    }
+
+    bool linear_regex::match(std::string_view input) const {
+        lock_guard<mutex> lock{dfa_mutex};
+        return !run(input).accepts.empty();
+    }
+
+    void linear_regex::match_all(std::string_view input, std::pmr::vector<bool>& matched) const {
+        matched.assign(patterns, false);
+
+        lock_guard<mutex> lock{dfa_mutex};
+        for(uint32_t p : run(input).accepts) {
+            matched[p] = true;
+        }
+    }
+}
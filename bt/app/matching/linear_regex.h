@@ -0,0 +1,123 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <bitset>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+
+namespace bt::matching {
+
+    /**
+     * @brief Regex engine with guaranteed linear matching time: patterns are compiled into a Thompson NFA, which is
+     * turned into a DFA lazily, one state at a time, as input is seen. Only answers whether the whole input matches
+     * (like std::regex_match), without captures.
+     *
+     * Supports the ECMAScript subset rules use: literals, ".", classes ([a-z], [^...], \d, \w, \s and negations),
+     * groups, alternation, greedy and lazy quantifiers (*, +, ?, {n}, {n,}, {n,m}), and ^/$ at the start/end of
+     * the pattern. Anything else (back references, lookarounds, word boundaries) is reported as unsupported, and
+     * callers should fall back to std::regex.
+     *
+     * Several patterns can be compiled together, in which case a single pass over the input tells which of them match.
+     */
+    class linear_regex {
+    public:
+
+        /**
+         * @brief NFA size limit. Patterns that expand to more states (large counted repetitions) are unsupported.
+         */
+        static constexpr size_t MaxStates = 10000;
+
+        /**
+         * @brief Number of DFA states kept before the cache is flushed. Bounds memory for patterns whose DFA explodes.
+         */
+        static constexpr size_t MaxCachedStates = 1024;
+
+        /**
+         * @brief Compiles patterns into one automaton.
+         * @param icase ASCII case-insensitive, same as std::regex icase in the "C" locale
+         * @return nullptr if any of the patterns is unsupported or invalid
+         */
+        static std::shared_ptr<const linear_regex> compile(const std::vector<std::string>& patterns, bool icase = true);
+
+        static std::shared_ptr<const linear_regex> compile(std::string_view pattern, bool icase = true);
+
+        /**
+         * @brief Whether compile() would accept the pattern.
+         */
+        static bool is_supported(std::string_view pattern);
+
+        size_t pattern_count() const { return patterns; }
+
+        /**
+         * @brief Whether any of the patterns matches the whole input.
+         */
+        bool match(std::string_view input) const;
+
+        /**
+         * @brief Tests all patterns in a single pass.
+         * @param matched resized to pattern_count(), matched[i] is set if pattern i matches the whole input
+         */
+        void match_all(std::string_view input, std::pmr::vector<bool>& matched) const;
+
+        linear_regex(const linear_regex&) = delete;
+        linear_regex& operator=(const linear_regex&) = delete;
+
+    private:
+        struct nfa_state {
+            enum class kind : std::uint8_t {
+                consume,    // consumes one byte from sets[arg], continues to out
+                split,      // continues to both out and out1 (if set) without consuming
+                accept      // pattern matched
+            };
+
+            kind k;
+            std::uint32_t arg;    // byte set for consume, pattern for accept
+            std::uint32_t out;
+            std::uint32_t out1;
+        };
+
+        struct dfa_state {
+            std::vector<std::uint32_t> nfa;         // consume and accept states only, sorted
+            std::vector<std::uint32_t> accepts;     // patterns accepted in this state
+            std::array<std::int32_t, 256> next;     // -1 until computed
+        };
+
+        static constexpr std::uint32_t None = UINT32_MAX;
+        static constexpr std::int32_t Unknown = -1;
+
+        linear_regex() = default;
+
+        class parser;
+
+        size_t patterns{0};
+        std::vector<nfa_state> states;
+        std::vector<std::bitset<256>> sets;
+        std::uint32_t start{None};
+
+        // lazily built DFA, shared by all callers
+        mutable std::mutex dfa_mutex;
+        mutable std::vector<std::unique_ptr<dfa_state>> dfa;
+        mutable std::unordered_map<std::string, std::int32_t> dfa_ids;
+        mutable std::int32_t dfa_start{Unknown};
+
+        std::uint32_t add_state(nfa_state::kind k, std::uint32_t arg, std::uint32_t out, std::uint32_t out1 = None);
+
+        /**
+         * @brief Finds or creates DFA state for the set of NFA states. Flushes the cache when it's full.
+         * @param flushed set to true if the cache was flushed, which invalidates all other state ids
+         */
+        std::int32_t get_dfa_state(std::vector<std::uint32_t>& nfa_set, bool& flushed) const;
+        void add_closure(std::uint32_t s, std::vector<std::uint32_t>& set, std::vector<bool>& seen) const;
+        std::int32_t step(std::int32_t from, std::uint8_t b) const;
+
+        /**
+         * @brief Runs DFA over the input, returns the final state. Caller must hold dfa_mutex.
+         */
+        const dfa_state& run(std::string_view input) const;
+    };
+}
@@ -0,0 +1,208 @@
+#include "matcher.h"
+#include "ci_search.h"
+#include "regex_prefilter.h"
+#include "predicate_dag.h"
+#include <array>
+#include <regex>
+#include <str.h>
+
+using namespace std;
+
+namespace bt::matching {
+
+    const string_view Whitespace = " \t\r\n\v\f";
+
+    static string_view trim(string_view s) {
+        size_t start = s.find_first_not_of(Whitespace);
+        if(start == string_view::npos) return {};
+        size_t end = s.find_last_not_of(Whitespace);
+        return s.substr(start, end - start + 1);
+    }
+
+    regex_batch_results::regex_batch_results(const regex_batch& batch, std::pmr::memory_resource* mem)
+        : batch{batch},
+        matched{pmr::vector<bool>(mem), pmr::vector<bool>(mem), pmr::vector<bool>(mem), pmr::vector<bool>(mem),
+            pmr::vector<bool>(mem)} {
+    }
+
+    bool regex_batch_results::test(input_part part, std::uint32_t slot, std::string_view input) {
+        size_t i = static_cast<size_t>(part);
+        if(!evaluated[i]) {
+            batch.sets[i]->match_all(input, matched[i]);
+            evaluated[i] = true;
+        }
+        return matched[i][slot];
+    }
+
+    void regex_batch_results::evaluate_all(const std::array<std::string_view, InputPartCount>& inputs) {
+        for(size_t i = 0; i < InputPartCount; i++) {
+            if(!batch.sets[i] || evaluated[i]) continue;
+            batch.sets[i]->match_all(inputs[i], matched[i]);
+            evaluated[i] = true;
+        }
+    }
+
+    match_context match_context::of(const click_payload& up, const script_site* script,
+        std::pmr::memory_resource* mem) {
+        match_context ctx{up, script};
+        ctx.mem = mem;
+
+        ctx.url = trim(up.url);
+        ctx.title = trim(up.window_title);
+        ctx.process = trim(up.process_name);
+
+        // same as match_rule::parse_url, but without allocating
+        const string_view prot_end("://");
+        size_t idx = ctx.url.find(prot_end);
+        ctx.host = idx == string_view::npos ? ctx.url : ctx.url.substr(idx + prot_end.size());
+        idx = ctx.host.find('/');
+        if(idx != string_view::npos) {
+            ctx.path = ctx.host.substr(idx + 1);
+            ctx.host = ctx.host.substr(0, idx);
+        }
+
+        return ctx;
+    }
+
+    match_kind kind_of(const match_rule& mr) {
+        if(mr.loc == match_location::lua_script) return match_kind::lua;
+        if(mr.type == match_type::regex) return match_kind::regex;
+        if(mr.type == match_type::glob) return match_kind::glob;
+        if(mr.type == match_type::list) return match_kind::list;
+        if(mr.type == match_type::expr) return match_kind::expr;
+        if(mr.type == match_type::exact) return match_kind::exact;
+        return mr.is_ascii() ? match_kind::substring : match_kind::substring_unicode;
+    }
+
+    const std::string& needle_of(const match_rule& mr) {
+        match_kind k = kind_of(mr);
+        return k == match_kind::substring || k == match_kind::exact ? mr.get_folded_value() : mr.value;
+    }
+
+    /**
+     * @brief The one matcher template. Every decision on rule metadata is made at compile time.
+     */
+    template<match_location L, match_scope S, match_kind K>
+    static bool match(const rule_ref& r, const match_context& ctx) {
+        if constexpr(K == match_kind::lua) {
+            if(!ctx.script) return false;
+            if(!ctx.lua) ctx.lua = ctx.script->acquire();
+            return ctx.lua && ctx.lua.call_rule(ctx.up, r.rule->value);
+        } else if constexpr(K == match_kind::list) {
+            const domain_list* dl = r.rule->get_domain_list();
+            return dl && !ctx.host.empty() && dl->contains_host(ctx.host);
+        } else if constexpr(K == match_kind::expr) {
+            if(ctx.predicates && r.predicate != rule_ref::NoSlot) {
+                return ctx.predicates->test(r.predicate, ctx);
+            }
+
+            // rule on its own, outside of a rule table
+            const predicate_dag* dag = r.rule->get_expression();
+            if(!dag) return false;
+            predicate_results results{*dag, ctx.mem};
+            return results.test(r.rule->get_expression_root(), ctx);
+        } else {
+            if(r.needle.empty()) return false;
+
+            // empty input never matches, even if a part of it (host or path) is what gets searched
+            string_view src;
+            if constexpr(L == match_location::url) {
+                if(ctx.url.empty()) return false;
+                if constexpr(S == match_scope::domain) {
+                    src = ctx.host;
+                } else if constexpr(S == match_scope::path) {
+                    src = ctx.path;
+                } else {
+                    src = ctx.url;
+                }
+            } else if constexpr(L == match_location::window_title) {
+                if(ctx.title.empty()) return false;
+                src = ctx.title;
+            } else if constexpr(L == match_location::process_name) {
+                if(ctx.process.empty()) return false;
+                src = ctx.process;
+            } else {
+                return false;
+            }
+
+            if constexpr(K == match_kind::substring) {
+                return ci_search::contains(src, r.needle);
+            } else if constexpr(K == match_kind::exact) {
+                return ci_search::equals(src, r.needle);
+            } else if constexpr(K == match_kind::substring_unicode) {
+                return str::contains_ic(string{src}, string{r.needle});
+            } else if constexpr(K == match_kind::glob) {
+                const glob* g = r.rule->get_glob();
+                return g && g->match(src);
+            } else {
+                const auto& linear = r.rule->get_linear_regex();
+                const regex* rx = r.rule->get_compiled_regex();
+                if(!linear && !rx) return false;
+
+                // regex is expensive, don't run it when the input lacks literals the pattern requires
+                if(!regex_prefilter::may_match(src, r.rule->get_required_literals())) {
+                    regex_prefilter::record(true, false);
+                    return false;
+                }
+
+                bool ok;
+                if(ctx.regexes && r.regex_slot != rule_ref::NoSlot) {
+                    ok = ctx.regexes->test(part_of(L, S), r.regex_slot, src);
+                } else if(linear) {
+                    ok = linear->match(src);
+                } else {
+                    match_results<const char*, pmr::polymorphic_allocator<sub_match<const char*>>> m{ctx.mem};
+                    ok = regex_match(src.data(), src.data() + src.size(), m, *rx);
+                }
+                regex_prefilter::record(false, ok);
+                return ok;
+            }
+        }
+    }
+
+    constexpr size_t LocationCount = 4;
+    constexpr size_t ScopeCount = 3;
+    constexpr size_t KindCount = 8;
+
+    template<match_location L, match_scope S>
+    constexpr array<matcher_fn, KindCount> make_kinds() {
+        return {
+            &match<L, S, match_kind::substring>,
+            &match<L, S, match_kind::substring_unicode>,
+            &match<L, S, match_kind::regex>,
+            &match<L, S, match_kind::lua>,
+            &match<L, S, match_kind::glob>,
+            &match<L, S, match_kind::list>,
+            &match<L, S, match_kind::expr>,
+            &match<L, S, match_kind::exact>
+        };
+    }
+
+    template<match_location L>
+    constexpr array<array<matcher_fn, KindCount>, ScopeCount> make_scopes() {
+        return {
+            make_kinds<L, match_scope::any>(),
+            make_kinds<L, match_scope::domain>(),
+            make_kinds<L, match_scope::path>()
+        };
+    }
+
+    // [location][scope][kind]
+    constexpr array<array<array<matcher_fn, KindCount>, ScopeCount>, LocationCount> matchers{
+        make_scopes<match_location::url>(),
+        make_scopes<match_location::window_title>(),
+        make_scopes<match_location::process_name>(),
+        make_scopes<match_location::lua_script>()
+    };
+
+    matcher_fn get_matcher(match_location loc, match_scope scope, match_kind kind) {
+        size_t li = static_cast<size_t>(loc);
+        size_t si = loc == match_location::url ? static_cast<size_t>(scope) : 0;
+        size_t ki = static_cast<size_t>(kind);
+        if(li >= LocationCount || si >= ScopeCount || ki >= KindCount) {
+            // not a valid combination, use a matcher that never matches
+            return &match<match_location::lua_script, match_scope::any, match_kind::substring>;
+        }
+        return matchers[li][si][ki];
+    }
+}
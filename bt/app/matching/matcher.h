@@ -0,0 +1,162 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <memory_resource>
+#include <array>
+#include <memory>
+#include <cstdint>
+#include "../match_rule.h"
+#include "../click_payload.h"
+#include "../script_site.h"
+#include "linear_regex.h"
+
+namespace bt::matching {
+
+    /**
+     * @brief How rule value is compared to the input.
+     */
+    enum class match_kind : unsigned int {
+        substring           = 0,    // ASCII case-insensitive substring, needle is pre-folded
+        substring_unicode   = 1,    // case-insensitive substring with non-ASCII characters in the needle
+        regex               = 2,
+        lua                 = 3,
+        glob                = 4,
+        list                = 5,    // domain list, looks at URL host whatever the location and scope
+        expr                = 6,    // compound expression, looks at whatever its tests name
+        exact               = 7     // whole input equals the pre-folded needle, ASCII case-insensitive
+    };
+
+    /**
+     * @brief Part of the input a rule looks at.
+     */
+    enum class input_part : unsigned int {
+        url     = 0,
+        host    = 1,
+        path    = 2,
+        title   = 3,
+        process = 4
+    };
+
+    constexpr size_t InputPartCount = 5;
+
+    constexpr input_part part_of(match_location loc, match_scope scope) {
+        switch(loc) {
+            case match_location::window_title: return input_part::title;
+            case match_location::process_name: return input_part::process;
+            default:
+                return scope == match_scope::domain ? input_part::host
+                    : scope == match_scope::path ? input_part::path
+                    : input_part::url;
+        }
+    }
+
+    /**
+     * @brief Regex rules compiled together, one automaton per input part, so that a single pass over the input
+     * evaluates all of them. Each rule is identified by its slot (pattern index) in the automaton of its part.
+     */
+    struct regex_batch {
+        std::array<std::shared_ptr<const linear_regex>, InputPartCount> sets;
+    };
+
+    /**
+     * @brief Results of a regex_batch for a single click. Each part is evaluated when one of its rules is first asked for.
+     */
+    class regex_batch_results {
+    public:
+        regex_batch_results(const regex_batch& batch, std::pmr::memory_resource* mem);
+
+        bool test(input_part part, std::uint32_t slot, std::string_view input);
+
+        /**
+         * @brief Evaluates every part the batch has rules for, instead of when first asked for. After that test() only
+         * reads, so it can be called from several threads at once.
+         * @param inputs by input_part
+         */
+        void evaluate_all(const std::array<std::string_view, InputPartCount>& inputs);
+
+    private:
+        const regex_batch& batch;
+        std::array<std::pmr::vector<bool>, InputPartCount> matched;
+        std::array<bool, InputPartCount> evaluated{};
+    };
+
+    class predicate_results;
+
+    /**
+     * @brief Everything rules can look at, extracted from the click once and shared by all rules.
+     */
+    struct match_context {
+        const click_payload& up;
+        const script_site* script;
+        std::string_view url;
+        std::string_view host;
+        std::string_view path;
+        std::string_view title;
+        std::string_view process;
+
+        /**
+         * @brief Where matchers allocate their temporaries (e.g. regex results).
+         */
+        std::pmr::memory_resource* mem;
+
+        /**
+         * @brief Batched regex results, optional.
+         */
+        regex_batch_results* regexes{nullptr};
+
+        /**
+         * @brief Memoized results of the shared expression graph, optional.
+         */
+        predicate_results* predicates{nullptr};
+
+        /**
+         * @brief Lua state all Lua rules of the click run in, taken from the script's pool by the first of them.
+         */
+        mutable script_site::lease lua;
+
+        /**
+         * @brief Trims inputs and splits URL into parts. Views point into the payload, which must outlive the context.
+         * @param script optional, Lua rules never match without it
+         */
+        static match_context of(const click_payload& up, const script_site* script,
+            std::pmr::memory_resource* mem = std::pmr::get_default_resource());
+    };
+
+    /**
+     * @brief What a matcher needs to know about a rule.
+     */
+    struct rule_ref {
+        static constexpr std::uint32_t NoSlot = UINT32_MAX;
+
+        std::string_view needle;
+        const match_rule* rule;
+
+        /**
+         * @brief Slot in the regex_batch, for regex rules that are batched.
+         */
+        std::uint32_t regex_slot{NoSlot};
+
+        /**
+         * @brief Node in the shared predicate_dag, for expression rules matched through a rule table.
+         */
+        std::uint32_t predicate{NoSlot};
+    };
+
+    using matcher_fn = bool (*)(const rule_ref& r, const match_context& ctx);
+
+    match_kind kind_of(const match_rule& mr);
+
+    /**
+     * @brief Value a matcher expects as the needle for this rule (folded for ASCII substring rules).
+     */
+    const std::string& needle_of(const match_rule& mr);
+
+    /**
+     * @brief Returns matcher specialised for this combination. Scope is ignored for anything but URL rules.
+     */
+    matcher_fn get_matcher(match_location loc, match_scope scope, match_kind kind);
+
+    inline matcher_fn get_matcher(const match_rule& mr) {
+        return get_matcher(mr.loc, mr.scope, kind_of(mr));
+    }
+}
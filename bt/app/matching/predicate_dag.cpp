@@ -0,0 +1,251 @@
+#include "predicate_dag.h"
+#include "ci_search.h"
+#include <algorithm>
+#include <fmt/core.h>
+#include <str.h>
+
+using namespace std;
+
+namespace bt::matching {
+
+    static inline char fold(char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+    }
+
+    static bool equals_ic(string_view a, string_view b) {
+        if(a.size() != b.size()) return false;
+        for(size_t i = 0; i < a.size(); i++) {
+            if(fold(a[i]) != fold(b[i])) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Recursive descent parser, adds nodes to the graph as it goes.
+     *
+     * expr  := and ("or" and)*
+     * and   := unary ("and" unary)*
+     * unary := "not" unary | "(" expr ")" | name ":" value
+     */
+    class predicate_dag::parser {
+    public:
+        parser(predicate_dag& dag, string_view src) : dag{dag}, src{src} {}
+
+        uint32_t parse(string& error) {
+            uint32_t root = parse_or(0);
+            skip_ws();
+            if(root != NoNode && pos < src.size()) {
+                fail(fmt::format("unexpected '{}'", src.substr(pos, 1)));
+                root = NoNode;
+            }
+            error = this->error;
+            return root;
+        }
+
+    private:
+        predicate_dag& dag;
+        string_view src;
+        size_t pos{0};
+        string error;
+
+        uint32_t fail(const string& message) {
+            if(error.empty()) error = fmt::format("{} at position {}", message, pos + 1);
+            return NoNode;
+        }
+
+        void skip_ws() {
+            while(pos < src.size() && (src[pos] == ' ' || src[pos] == '\t')) pos++;
+        }
+
+        /**
+         * @brief Consumes keyword if it's next, as a whole word.
+         */
+        bool keyword(string_view kw) {
+            skip_ws();
+            if(pos + kw.size() > src.size() || !equals_ic(src.substr(pos, kw.size()), kw)) return false;
+            size_t end = pos + kw.size();
+            if(end < src.size() && src[end] != ' ' && src[end] != '\t' && src[end] != '(') return false;
+            pos = end;
+            return true;
+        }
+
+        uint32_t parse_or(size_t depth) {
+            vector<uint32_t> children{parse_and(depth)};
+            while(children.back() != NoNode && keyword("or")) {
+                children.push_back(parse_and(depth));
+            }
+            if(children.back() == NoNode) return NoNode;
+            return dag.make_group(node_type::any, std::move(children));
+        }
+
+        uint32_t parse_and(size_t depth) {
+            vector<uint32_t> children{parse_unary(depth)};
+            while(children.back() != NoNode && keyword("and")) {
+                children.push_back(parse_unary(depth));
+            }
+            if(children.back() == NoNode) return NoNode;
+            return dag.make_group(node_type::all, std::move(children));
+        }
+
+        uint32_t parse_unary(size_t depth) {
+            if(depth >= MaxDepth) return fail("expression is nested too deep");
+
+            if(keyword("not")) {
+                uint32_t child = parse_unary(depth + 1);
+                return child == NoNode ? NoNode : dag.make_negate(child);
+            }
+
+            skip_ws();
+            if(pos >= src.size()) return fail("expected a test");
+
+            if(src[pos] == '(') {
+                pos++;
+                uint32_t inner = parse_or(depth + 1);
+                if(inner == NoNode) return NoNode;
+                skip_ws();
+                if(pos >= src.size() || src[pos] != ')') return fail("expected ')'");
+                pos++;
+                return inner;
+            }
+
+            return parse_test();
+        }
+
+        uint32_t parse_test() {
+            size_t colon = src.find(':', pos);
+            if(colon == string_view::npos) return fail("expected a test such as 'url:value'");
+
+            string_view name = src.substr(pos, colon - pos);
+            input_part part;
+            if(equals_ic(name, "url")) part = input_part::url;
+            else if(equals_ic(name, "domain")) part = input_part::host;
+            else if(equals_ic(name, "path")) part = input_part::path;
+            else if(equals_ic(name, "title")) part = input_part::title;
+            else if(equals_ic(name, "process")) part = input_part::process;
+            else return fail(fmt::format("unknown test '{}'", name));
+            pos = colon + 1;
+
+            string value;
+            if(pos < src.size() && src[pos] == '"') {
+                size_t end = src.find('"', pos + 1);
+                if(end == string_view::npos) return fail("missing closing quote");
+                value = src.substr(pos + 1, end - pos - 1);
+                pos = end + 1;
+            } else {
+                size_t end = pos;
+                while(end < src.size() && src[end] != ' ' && src[end] != '\t' && src[end] != '(' && src[end] != ')') end++;
+                value = src.substr(pos, end - pos);
+                pos = end;
+            }
+
+            if(value.empty()) return fail("empty value");
+            return dag.make_test(part, std::move(value));
+        }
+    };
+
+    std::uint32_t predicate_dag::add(std::string_view expression, std::string* error) {
+        // nodes of an invalid expression stay in the graph, harmless as nothing refers to them
+        string e;
+        uint32_t root = parser{*this, expression}.parse(e);
+        if(error) *error = e;
+        return root;
+    }
+
+    bool predicate_dag::is_valid(std::string_view expression, std::string* error) {
+        predicate_dag dag;
+        return dag.add(expression, error) != NoNode;
+    }
+
+    std::uint32_t predicate_dag::intern(node&& n) {
+        string key;
+        if(n.type == node_type::test) {
+            key = fmt::format("t{}:{}", static_cast<unsigned>(n.part), n.needle);
+        } else {
+            key = fmt::format("{}", static_cast<unsigned>(n.type));
+            for(uint32_t c : n.children) key += fmt::format(",{}", c);
+        }
+
+        auto it = ids.find(key);
+        if(it != ids.end()) return it->second;
+
+        if(n.type == node_type::test) input_parts |= 1u << static_cast<uint32_t>(n.part);
+        uint32_t id = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(std::move(n));
+        ids.emplace(std::move(key), id);
+        return id;
+    }
+
+    std::uint32_t predicate_dag::make_test(input_part part, std::string value) {
+        node n{node_type::test, part};
+        n.ascii = ci_search::is_ascii(value);
+        ci_search::fold_ascii(value);
+        n.needle = std::move(value);
+        return intern(std::move(n));
+    }
+
+    std::uint32_t predicate_dag::make_negate(std::uint32_t child) {
+        // not not x is x
+        if(nodes[child].type == node_type::negate) return nodes[child].children[0];
+        return intern(node{node_type::negate, input_part::url, true, {}, {child}});
+    }
+
+    std::uint32_t predicate_dag::make_group(node_type type, std::vector<std::uint32_t> children) {
+        // (a and b) and c is the same as a and b and c
+        vector<uint32_t> flat;
+        for(uint32_t c : children) {
+            if(nodes[c].type == type) {
+                flat.insert(flat.end(), nodes[c].children.begin(), nodes[c].children.end());
+            } else {
+                flat.push_back(c);
+            }
+        }
+
+        // order doesn't change the outcome, so "a and b" and "b and a" share a node
+        sort(flat.begin(), flat.end());
+        flat.erase(unique(flat.begin(), flat.end()), flat.end());
+        if(flat.size() == 1) return flat[0];
+
+        return intern(node{type, input_part::url, true, {}, std::move(flat)});
+    }
+
+    predicate_results::predicate_results(const predicate_dag& dag, std::pmr::memory_resource* mem)
+        : dag{dag}, state(dag.size(), unknown, mem) {
+    }
+
+    bool predicate_results::test(std::uint32_t id, const match_context& ctx) {
+        if(state[id] != unknown) return state[id] == yes;
+        evaluated++;
+
+        const predicate_dag::node& n = dag.get(id);
+        bool r{false};
+        switch(n.type) {
+            case predicate_dag::node_type::test:
+            {
+                string_view src;
+                switch(n.part) {
+                    case input_part::url: src = ctx.url; break;
+                    case input_part::host: src = ctx.host; break;
+                    case input_part::path: src = ctx.path; break;
+                    case input_part::title: src = ctx.title; break;
+                    case input_part::process: src = ctx.process; break;
+                }
+                r = !src.empty() && (n.ascii
+                    ? ci_search::contains(src, n.needle)
+                    : str::contains_ic(string{src}, n.needle));
+            }
+            break;
+            case predicate_dag::node_type::all:
+                r = all_of(n.children.begin(), n.children.end(), [&](uint32_t c) { return test(c, ctx); });
+                break;
+            case predicate_dag::node_type::any:
+                r = any_of(n.children.begin(), n.children.end(), [&](uint32_t c) { return test(c, ctx); });
+                break;
+            case predicate_dag::node_type::negate:
+                r = !test(n.children[0], ctx);
+                break;
+        }
+
+        state[id] = r ? yes : no;
+        return r;
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <memory_resource>
+#include <cstdint>
+#include "matcher.h"
+
+namespace bt::matching {
+
+    /**
+     * @brief Compound ("type:expr") rules compiled into a single graph of predicates.
+     *
+     * Expressions combine substring tests on parts of the click with "and", "or", "not" and parentheses, for example
+     * `domain:teams.microsoft.com and (process:outlook.exe or not title:"Private chat")`. Tests are `url:`, `domain:`,
+     * `path:`, `title:` and `process:` followed by a value, quoted if it contains spaces or parentheses. Values are
+     * matched case-insensitively anywhere in the part.
+     *
+     * Identical tests and sub-expressions are stored once, no matter how many rules use them, so each is evaluated at
+     * most once per click (see predicate_results).
+     */
+    class predicate_dag {
+    public:
+        static constexpr std::uint32_t NoNode = UINT32_MAX;
+
+        /**
+         * @brief Expressions nested deeper than this are rejected.
+         */
+        static constexpr size_t MaxDepth = 32;
+
+        enum class node_type : std::uint8_t {
+            test,
+            all,        // and
+            any,        // or
+            negate      // not
+        };
+
+        struct node {
+            node_type type;
+            input_part part{input_part::url};
+            bool ascii{true};
+
+            /**
+             * @brief Folded value, for tests.
+             */
+            std::string needle;
+
+            /**
+             * @brief Always added to the graph before their parents, so have lower ids.
+             */
+            std::vector<std::uint32_t> children;
+        };
+
+        /**
+         * @brief Parses expression and adds it to the graph, reusing nodes already there.
+         * @param error set to a description of the problem if the expression is invalid
+         * @return root node of the expression, or NoNode if it's invalid
+         */
+        std::uint32_t add(std::string_view expression, std::string* error = nullptr);
+
+        /**
+         * @brief Whether the expression is valid.
+         */
+        static bool is_valid(std::string_view expression, std::string* error = nullptr);
+
+        const node& get(std::uint32_t id) const { return nodes[id]; }
+
+        size_t size() const { return nodes.size(); }
+
+        /**
+         * @brief Bit mask of input parts (1 << input_part) tested anywhere in the graph.
+         */
+        std::uint32_t get_input_parts() const { return input_parts; }
+
+    private:
+        class parser;
+
+        std::vector<node> nodes;
+
+        /**
+         * @brief Canonical form of every node, for sharing.
+         */
+        std::unordered_map<std::string, std::uint32_t> ids;
+
+        std::uint32_t input_parts{0};
+
+        std::uint32_t intern(node&& n);
+        std::uint32_t make_test(input_part part, std::string value);
+        std::uint32_t make_negate(std::uint32_t child);
+        std::uint32_t make_group(node_type type, std::vector<std::uint32_t> children);
+    };
+
+    /**
+     * @brief Memoized results of predicate_dag nodes for a single click.
+     */
+    class predicate_results {
+    public:
+        predicate_results(const predicate_dag& dag, std::pmr::memory_resource* mem);
+
+        bool test(std::uint32_t id, const match_context& ctx);
+
+        /**
+         * @brief How many nodes were actually evaluated, for tests and diagnostics.
+         */
+        size_t get_evaluated_count() const { return evaluated; }
+
+    private:
+        enum : std::uint8_t { unknown = 0, no = 1, yes = 2 };
+
+        const predicate_dag& dag;
+        std::pmr::vector<std::uint8_t> state;
+        size_t evaluated{0};
+    };
+}
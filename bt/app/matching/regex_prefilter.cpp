@@ -0,0 +1,222 @@
+#include "regex_prefilter.h"
+#include "ci_search.h"
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+
+namespace bt::matching {
+
+    atomic<uint64_t> regex_prefilter::evaluated{0};
+    atomic<uint64_t> regex_prefilter::skipped{0};
+    atomic<uint64_t> regex_prefilter::executed{0};
+    atomic<uint64_t> regex_prefilter::matched{0};
+
+    const string_view SpecialChars = ".^$*+?{}()[]|";
+
+    /**
+     * @brief Skips bracket expression starting at i, returns position after the closing bracket.
+     */
+    static size_t skip_class(string_view p, size_t i) {
+        i++;
+        if(i < p.size() && p[i] == '^') i++;
+        while(i < p.size() && p[i] != ']') {
+            if(p[i] == '\\') i++;
+            i++;
+        }
+        return min(i + 1, p.size());
+    }
+
+    /**
+     * @brief Skips group starting at i, returns position after the closing parenthesis.
+     */
+    static size_t skip_group(string_view p, size_t i) {
+        int depth{0};
+        while(i < p.size()) {
+            char c = p[i];
+            if(c == '\\') {
+                i += 2;
+                continue;
+            }
+            if(c == '[') {
+                i = skip_class(p, i);
+                continue;
+            }
+            if(c == '(') {
+                depth++;
+            } else if(c == ')' && --depth == 0) {
+                return i + 1;
+            }
+            i++;
+        }
+        return p.size();
+    }
+
+    static bool has_top_level_alternation(string_view p) {
+        for(size_t i = 0; i < p.size();) {
+            char c = p[i];
+            if(c == '\\') {
+                i += 2;
+            } else if(c == '[') {
+                i = skip_class(p, i);
+            } else if(c == '(') {
+                i = skip_group(p, i);
+            } else {
+                if(c == '|') return true;
+                i++;
+            }
+        }
+        return false;
+    }
+
+    struct quantifier {
+        size_t min{1};
+        bool repeats{false};
+        size_t end;
+    };
+
+    /**
+     * @brief Parses quantifier at i. If there is none, the atom before it occurs exactly once.
+     */
+    static quantifier parse_quantifier(string_view p, size_t i) {
+        quantifier q{1, false, i};
+        if(i >= p.size()) return q;
+
+        switch(p[i]) {
+            case '*':
+                q = {0, true, i + 1};
+                break;
+            case '+':
+                q = {1, true, i + 1};
+                break;
+            case '?':
+                q = {0, false, i + 1};
+                break;
+            case '{': {
+                size_t close = p.find('}', i);
+                if(close == string_view::npos) return q;
+                string_view body = p.substr(i + 1, close - i - 1);
+                string_view lo = body.substr(0, body.find(','));
+                if(lo.empty() || lo.find_first_not_of("0123456789") != string_view::npos) return q;
+                q.min = lo.find_first_not_of('0') == string_view::npos ? 0 : 1;
+                q.repeats = body != "1";
+                q.end = close + 1;
+                break;
+            }
+            default:
+                return q;
+        }
+
+        // lazy quantifier
+        if(q.end < p.size() && p[q.end] == '?') q.end++;
+        return q;
+    }
+
+    std::vector<std::string> regex_prefilter::extract(std::string_view p) {
+        vector<string> r;
+
+        // with alternation at the top, no single literal is required
+        if(has_top_level_alternation(p)) return r;
+
+        string run;
+        auto flush = [&r, &run]() {
+            if(run.size() >= MinLiteralLength && ci_search::is_ascii(run)) {
+                ci_search::fold_ascii(run);
+                r.push_back(run);
+            }
+            run.clear();
+        };
+
+        size_t i{0};
+        while(i < p.size()) {
+            char c = p[i];
+            int lit{-1};
+
+            if(c == '\\') {
+                if(i + 1 >= p.size()) break;
+                char e = p[i + 1];
+                i += 2;
+                if(!isalnum(static_cast<unsigned char>(e))) {
+                    lit = static_cast<unsigned char>(e);
+                } else {
+                    // character class, assertion, control character or back reference, skip its arguments
+                    if(e == 'x') i += 2;
+                    else if(e == 'u') i += 4;
+                    else if(e == 'c') i += 1;
+                    else if(isdigit(static_cast<unsigned char>(e))) {
+                        while(i < p.size() && isdigit(static_cast<unsigned char>(p[i]))) i++;
+                    }
+                    flush();
+                }
+            } else if(c == '[') {
+                flush();
+                i = skip_class(p, i);
+            } else if(c == '(') {
+                flush();
+                i = skip_group(p, i);
+            } else if(SpecialChars.find(c) != string_view::npos) {
+                flush();
+                i++;
+            } else {
+                lit = static_cast<unsigned char>(c);
+                i++;
+            }
+
+            quantifier q = parse_quantifier(p, min(i, p.size()));
+            i = q.end;
+
+            if(lit >= 0) {
+                if(q.min == 0) {
+                    // optional, but everything before it is still required
+                    flush();
+                } else {
+                    run += static_cast<char>(lit);
+                    if(q.repeats) flush();
+                }
+            }
+        }
+        flush();
+
+        // longest literals are the most selective, check them first
+        sort(r.begin(), r.end(), [](const string& a, const string& b) {
+            return a.size() != b.size() ? a.size() > b.size() : a < b;
+        });
+        r.erase(unique(r.begin(), r.end()), r.end());
+        if(r.size() > MaxLiterals) r.resize(MaxLiterals);
+
+        return r;
+    }
+
+    bool regex_prefilter::may_match(std::string_view input, const std::vector<std::string>& literals) {
+        for(const string& lit : literals) {
+            if(!ci_search::contains(input, lit)) return false;
+        }
+        return true;
+    }
+
+    void regex_prefilter::record(bool was_skipped, bool was_matched) {
+        evaluated.fetch_add(1, memory_order_relaxed);
+        if(was_skipped) {
+            skipped.fetch_add(1, memory_order_relaxed);
+        } else {
+            executed.fetch_add(1, memory_order_relaxed);
+            if(was_matched) matched.fetch_add(1, memory_order_relaxed);
+        }
+    }
+
+    regex_prefilter::stats regex_prefilter::get_stats() {
+        return stats{
+            evaluated.load(memory_order_relaxed),
+            skipped.load(memory_order_relaxed),
+            executed.load(memory_order_relaxed),
+            matched.load(memory_order_relaxed)
+        };
+    }
+
+    void regex_prefilter::reset_stats() {
+        evaluated = 0;
+        skipped = 0;
+        executed = 0;
+        matched = 0;
+    }
+}
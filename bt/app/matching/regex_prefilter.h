@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+namespace bt::matching {
+
+    /**
+     * @brief Literals every input matching a regex must contain, so that the regex only runs when they are present.
+     * Extraction is conservative: anything it doesn't fully understand (groups, alternation, classes) simply contributes
+     * no literals, which means the regex always runs.
+     */
+    class regex_prefilter {
+    public:
+
+        /**
+         * @brief Literals shorter than this are not worth a separate scan.
+         */
+        static constexpr size_t MinLiteralLength = 2;
+
+        /**
+         * @brief At most this many literals are kept per regex, longest first.
+         */
+        static constexpr size_t MaxLiterals = 3;
+
+        struct stats {
+            std::uint64_t evaluated{0};     // regex rules looked at
+            std::uint64_t skipped{0};       // rejected by the prefilter, regex did not run
+            std::uint64_t executed{0};      // regex ran
+            std::uint64_t matched{0};       // regex ran and matched
+        };
+
+        /**
+         * @brief Extracts required literals from an ECMAScript pattern, folded with ci_search::fold_ascii. Literals
+         * containing non-ASCII characters are dropped, as regex case folding for them is locale dependent.
+         * @return literals, longest first, or empty if nothing is required
+         */
+        static std::vector<std::string> extract(std::string_view pattern);
+
+        /**
+         * @brief Whether all literals are present in the input.
+         */
+        static bool may_match(std::string_view input, const std::vector<std::string>& literals);
+
+        static void record(bool was_skipped, bool was_matched);
+
+        static stats get_stats();
+
+        static void reset_stats();
+
+    private:
+        static std::atomic<std::uint64_t> evaluated;
+        static std::atomic<std::uint64_t> skipped;
+        static std::atomic<std::uint64_t> executed;
+        static std::atomic<std::uint64_t> matched;
+    };
+}
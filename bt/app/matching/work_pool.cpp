@@ -0,0 +1,145 @@
+#include "work_pool.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace bt::matching {
+
+    work_pool::work_pool(size_t threads) : ranges{new range[threads + 1]} {
+        for(size_t i = 0; i < threads; i++) {
+            // participant 0 is the calling thread
+            this->threads.emplace_back(&work_pool::worker, this, i + 1);
+        }
+    }
+
+    work_pool::~work_pool() {
+        {
+            lock_guard<mutex> lock{m};
+            stopping = true;
+        }
+        job_posted.notify_all();
+        for(thread& t : threads) t.join();
+    }
+
+    work_pool& work_pool::get() {
+        static work_pool pool{max<size_t>(1, thread::hardware_concurrency()) - 1};
+        return pool;
+    }
+
+    void work_pool::parallel_for(size_t count, size_t chunk, const work_fn& fn) {
+        if(count == 0) return;
+        chunk = max<size_t>(1, chunk);
+
+        // not worth waking anyone up
+        if(threads.empty() || count <= chunk || count > UINT32_MAX) {
+            for(size_t begin = 0; begin < count; begin += chunk) {
+                fn(0, begin, min(count, begin + chunk));
+            }
+            return;
+        }
+
+        lock_guard<mutex> call_lock{call_mutex};
+
+        size_t n = get_participant_count();
+        for(size_t i = 0; i < n; i++) {
+            ranges[i].store(pack(static_cast<uint32_t>(count * i / n), static_cast<uint32_t>(count * (i + 1) / n)));
+        }
+
+        {
+            lock_guard<mutex> lock{m};
+            this->fn = &fn;
+            this->chunk = chunk;
+            error = nullptr;
+            active = threads.size();
+            job_id++;
+        }
+        job_posted.notify_all();
+
+        run(0);
+
+        // workers may still be finishing their last chunk
+        unique_lock<mutex> lock{m};
+        job_done.wait(lock, [this]() { return active == 0; });
+        this->fn = nullptr;
+        if(error) {
+            exception_ptr e = error;
+            error = nullptr;
+            rethrow_exception(e);
+        }
+    }
+
+    void work_pool::worker(size_t participant) {
+        uint64_t seen{0};
+        while(true) {
+            {
+                unique_lock<mutex> lock{m};
+                job_posted.wait(lock, [this, seen]() { return stopping || job_id != seen; });
+                if(stopping) return;
+                seen = job_id;
+            }
+
+            run(participant);
+
+            {
+                lock_guard<mutex> lock{m};
+                if(--active == 0) job_done.notify_one();
+            }
+        }
+    }
+
+    void work_pool::run(size_t participant) {
+        uint32_t begin, end;
+        while(true) {
+            if(!take(participant, begin, end)) {
+                if(!steal(participant)) return;
+                continue;
+            }
+
+            try {
+                (*fn)(participant, begin, end);
+            } catch(...) {
+                lock_guard<mutex> lock{m};
+                if(!error) error = current_exception();
+            }
+        }
+    }
+
+    bool work_pool::take(size_t participant, std::uint32_t& begin, std::uint32_t& end) {
+        range& r = ranges[participant];
+        uint64_t current = r.load();
+        while(true) {
+            uint32_t b = static_cast<uint32_t>(current);
+            uint32_t e = static_cast<uint32_t>(current >> 32);
+            if(b >= e) return false;
+
+            uint32_t next = e - b > chunk ? b + static_cast<uint32_t>(chunk) : e;
+            if(r.compare_exchange_weak(current, pack(next, e))) {
+                begin = b;
+                end = next;
+                return true;
+            }
+        }
+    }
+
+    bool work_pool::steal(size_t participant) {
+        size_t n = get_participant_count();
+        for(size_t k = 1; k < n; k++) {
+            range& victim = ranges[(participant + k) % n];
+            uint64_t current = victim.load();
+            while(true) {
+                uint32_t b = static_cast<uint32_t>(current);
+                uint32_t e = static_cast<uint32_t>(current >> 32);
+                if(b >= e) break;
+
+                // back half, the owner keeps working from the front
+                uint32_t mid = b + (e - b) / 2;
+                if(victim.compare_exchange_weak(current, pack(b, mid))) {
+                    // own range is empty, and nobody steals from an empty range, so a plain store is enough
+                    ranges[participant].store(pack(mid, e));
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <memory>
+#include <cstdint>
+
+namespace bt::matching {
+
+    /**
+     * @brief Fixed set of threads that split a range of work items between themselves and the calling thread.
+     *
+     * Each participant starts with an equal share of the range and takes chunks from its front. A participant that
+     * runs out steals the back half of whatever is left in another participant's share, so uneven work (e.g. a few
+     * expensive regex or Lua rules) doesn't leave threads idle.
+     */
+    class work_pool {
+    public:
+        /**
+         * @param threads number of threads besides the caller, 0 runs everything on the calling thread
+         */
+        explicit work_pool(size_t threads);
+        work_pool(const work_pool&) = delete;
+        work_pool& operator=(const work_pool&) = delete;
+        ~work_pool();
+
+        /**
+         * @brief Pool shared by the application, with a thread per hardware thread besides the caller's.
+         */
+        static work_pool& get();
+
+        /**
+         * @brief Number of participants, i.e. pool threads plus the caller. Participant indexes passed to work
+         * functions are below this.
+         */
+        size_t get_participant_count() const { return threads.size() + 1; }
+
+        using work_fn = std::function<void(size_t participant, size_t begin, size_t end)>;
+
+        /**
+         * @brief Calls fn for chunks covering [0, count), at most chunk items each, and returns when all are done. A
+         * participant only ever runs one chunk at a time. The first exception thrown by fn is rethrown here. One call at
+         * a time, concurrent callers wait.
+         */
+        void parallel_for(size_t count, size_t chunk, const work_fn& fn);
+
+    private:
+        // begin in the low half, end in the high half, so that both change in a single CAS
+        using range = std::atomic<std::uint64_t>;
+
+        static std::uint64_t pack(std::uint32_t begin, std::uint32_t end) {
+            return (static_cast<std::uint64_t>(end) << 32) | begin;
+        }
+
+        std::vector<std::thread> threads;
+        std::mutex call_mutex;
+
+        std::mutex m;
+        std::condition_variable job_posted;
+        std::condition_variable job_done;
+        bool stopping{false};
+
+        // current job
+        std::uint64_t job_id{0};
+        const work_fn* fn{nullptr};
+        size_t chunk{1};
+        std::unique_ptr<range[]> ranges;
+        size_t active{0};
+        std::exception_ptr error;
+
+        void worker(size_t participant);
+        void run(size_t participant);
+        bool take(size_t participant, std::uint32_t& begin, std::uint32_t& end);
+        bool steal(size_t participant);
+    };
+}
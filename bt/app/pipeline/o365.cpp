@@ -6,15 +6,15 @@ using namespace std;
 
 namespace bt::pipeline {
     void o365::process(click_payload& up) {
-        url u{up.url};
+        string_view host = host_of(up.url);
+        if(!host.ends_with(".safelinks.protection.outlook.com") &&
+            host != "statics.teams.cdn.office.net") return;
 
-        if(u.host.ends_with(".safelinks.protection.outlook.com") ||
-            u.host == "statics.teams.cdn.office.net") {
-            for(const auto& p : u.parameters) {
-                if(p.first == "url") {
-                    string url = p.second;
-                    up.url = str::url_decode(url);
-                }
+        url u{up.url};
+        for(const auto& p : u.parameters) {
+            if(p.first == "url") {
+                string url = p.second;
+                up.url = str::url_decode(url);
             }
         }
     }
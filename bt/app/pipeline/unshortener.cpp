@@ -1,7 +1,6 @@
 #include "unshortener.h"
 #include <map>
 #include <set>
-#include "url.h"
 
 using namespace std;
 
@@ -9,7 +8,7 @@ namespace bt::pipeline {
 
     const string LocationHeaderName = "Location";
 
-    const set<string> SupportedDomains = {
+    const set<string, less<>> SupportedDomains = {
         "adf.ly",
         "adfoc.us",
         "bc.vc",
@@ -53,7 +52,6 @@ namespace bt::pipeline {
     }
 
     bool unshortener::is_supported(const std::string& abs_url) {
-        url u{abs_url};
-        return SupportedDomains.contains(u.host);
+        return SupportedDomains.contains(host_of(abs_url));
     }
 }
\ No newline at end of file
@@ -0,0 +1,26 @@
+#include "router.h"
+#include "../globals.h"
+
+using namespace std;
+using namespace std::chrono;
+
+namespace bt {
+    route_result router::route(click_payload up) {
+        route_result r;
+        click_arena arena;
+
+        auto t0 = steady_clock::now();
+        g_pipeline.process(up);
+        auto t1 = steady_clock::now();
+        if(!g_config.get_routing()->browsers.empty()) {
+            r.matches = g_config.match(up, g_script, arena.get());
+        }
+        auto t2 = steady_clock::now();
+
+        r.up = up;
+        r.pipeline_time = t1 - t0;
+        r.match_time = t2 - t1;
+        r.allocations = arena.get_stats();
+        return r;
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <chrono>
+#include <vector>
+#include "browser.h"
+#include "click_payload.h"
+#include "click_arena.h"
+
+namespace bt {
+
+    /**
+     * @brief Outcome of routing a single click. Nothing is launched.
+     */
+    struct route_result {
+        /**
+         * @brief Payload after the URL pipeline was applied.
+         */
+        click_payload up;
+
+        /**
+         * @brief All matches, best first. The first element is the decision.
+         */
+        std::vector<browser_match_result> matches;
+
+        std::chrono::nanoseconds pipeline_time{0};
+        std::chrono::nanoseconds match_time{0};
+
+        /**
+         * @brief Temporary allocations made while routing this click.
+         */
+        click_arena::stats allocations;
+    };
+
+    /**
+     * @brief Runs the URL pipeline and the rule matcher against the current configuration, without launching anything.
+     */
+    class router {
+    public:
+        static route_result route(click_payload up);
+    };
+}
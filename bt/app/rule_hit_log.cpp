@@ -1,6 +1,7 @@
 #include "rule_hit_log.h"
 #include "config.h"
 #include <vector>
+#include <fstream>
 #include "datetime.h"
 
 using namespace std;
@@ -32,19 +33,110 @@ namespace bt {
         }
     }
 
-    void rule_hit_log::write(const bt::click_payload& up, std::shared_ptr<bt::browser_instance> bi, const std::string& rule) {
+    void rule_hit_log::write(const bt::click_payload& up, std::shared_ptr<bt::browser_instance> bi, const std::string& rule,
+        const std::string& clicked_url) {
         writer.write_row(vector<string>{
             datetime::to_iso_8601(),
-            bi->b->id,
-            bi->b->name,
-            bi->name,
-            up.url,
+            escape(bi->b->id),
+            escape(bi->b->name),
+            escape(bi->name),
+            escape(clicked_url),
             "",
-            up.url,
-            rule,
-            up.process_name,
-            up.window_title
+            escape(up.url),
+            escape(rule),
+            escape(up.process_name),
+            escape(up.window_title)
         });
         stream.flush();
     }
+
+    std::vector<rule_hit_log_entry> rule_hit_log::read(const std::string& path, size_t& skipped) {
+        vector<rule_hit_log_entry> r;
+        skipped = 0;
+
+        ifstream in(path);
+        if(!in.is_open()) return r;
+
+        string line;
+        vector<string> cells;
+        bool is_header{true};
+        while(getline(in, line)) {
+            if(!line.empty() && line.back() == '\r') line.pop_back();
+            if(line.empty()) continue;
+
+            if(is_header) {
+                is_header = false;
+                continue;
+            }
+
+            if(!parse_row(line, cells) || cells.size() != 10) {
+                skipped += 1;
+                continue;
+            }
+
+            rule_hit_log_entry e;
+            e.timestamp = cells[0];
+            e.browser_id = cells[1];
+            e.browser_name = cells[2];
+            e.profile_name = cells[3];
+            e.url = cells[4];
+            e.open_url = cells[6];
+            e.rule = cells[7];
+            e.process_name = cells[8];
+            e.window_title = cells[9];
+            r.push_back(std::move(e));
+        }
+
+        return r;
+    }
+
+    std::string rule_hit_log::escape(const std::string& value) {
+        // quote according to RFC 4180, and keep one record per line
+        if(value.find_first_of(",\"\r\n") == string::npos) return value;
+
+        string r{"\""};
+        for(char c : value) {
+            if(c == '"') {
+                r += "\"\"";
+            } else if(c == '\r' || c == '\n') {
+                r += ' ';
+            } else {
+                r += c;
+            }
+        }
+        r += '"';
+        return r;
+    }
+
+    bool rule_hit_log::parse_row(const std::string& line, std::vector<std::string>& cells) {
+        cells.clear();
+
+        string cell;
+        bool in_quotes{false};
+        for(size_t i = 0; i < line.size(); i++) {
+            char c = line[i];
+            if(in_quotes) {
+                if(c == '"') {
+                    if(i + 1 < line.size() && line[i + 1] == '"') {
+                        cell += '"';
+                        i++;
+                    } else {
+                        in_quotes = false;
+                    }
+                } else {
+                    cell += c;
+                }
+            } else if(c == '"' && cell.empty()) {
+                in_quotes = true;
+            } else if(c == ',') {
+                cells.push_back(std::move(cell));
+                cell.clear();
+            } else {
+                cell += c;
+            }
+        }
+        cells.push_back(std::move(cell));
+
+        return !in_quotes;
+    }
 }
\ No newline at end of file
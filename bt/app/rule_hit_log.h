@@ -4,14 +4,40 @@
 #include <csv2/writer.hpp>
 
 namespace bt {
+
+    struct rule_hit_log_entry {
+        std::string timestamp;
+        std::string browser_id;
+        std::string browser_name;
+        std::string profile_name;
+        std::string url;        // as clicked, before the pipeline
+        std::string open_url;   // as opened, after the pipeline and the rule
+        std::string rule;
+        std::string process_name;
+        std::string window_title;
+    };
+
     class rule_hit_log {
     public:
         rule_hit_log();
 
-        void write(const bt::click_payload& up, std::shared_ptr<bt::browser_instance> bi, const std::string& rule);
+        /**
+         * @param up click as opened
+         * @param clicked_url URL as clicked, before the pipeline changed it, so that replaying the log runs the same
+         * pipeline steps once
+         */
+        void write(const bt::click_payload& up, std::shared_ptr<bt::browser_instance> bi, const std::string& rule,
+            const std::string& clicked_url);
 
         std::string get_absolute_path() { return path; }
 
+        /**
+         * @brief Reads all entries from a hit log file.
+         * @param path Path to the log file
+         * @param skipped Number of rows that could not be parsed (e.g. written by older versions with unquoted commas)
+         */
+        static std::vector<rule_hit_log_entry> read(const std::string& path, size_t& skipped);
+
         // global instance
         static rule_hit_log i;
 
@@ -19,5 +45,8 @@ namespace bt {
         std::string path;
         std::ofstream stream;
         csv2::Writer<csv2::delimiter<','>> writer;
+
+        static std::string escape(const std::string& value);
+        static bool parse_row(const std::string& line, std::vector<std::string>& cells);
     };
 }
\ No newline at end of file
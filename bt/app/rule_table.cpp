@@ -0,0 +1,277 @@
+#include "rule_table.h"
+#include "browser.h"
+#include "decision_cache.h"
+#include "matching/work_pool.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory_resource>
+
+using namespace std;
+
+namespace bt {
+
+    std::uint32_t string_pool::intern(std::string_view s) {
+        auto it = ids.find(s);
+        if(it != ids.end()) return it->second;
+
+        uint32_t id = static_cast<uint32_t>(strings.size());
+        strings.emplace_back(s);
+        ids.emplace(strings.back(), id);
+        return id;
+    }
+
+    rule_table rule_table::build(const std::vector<std::shared_ptr<browser>>& browsers) {
+        rule_table t;
+        array<vector<string>, matching::InputPartCount> patterns;
+        uint64_t fp = decision_cache::HashBasis;
+
+        for(const auto& b : browsers) {
+            for(const auto& bi : b->instances) {
+                t.instances.push_back(bi);
+                t.first_rule.push_back(static_cast<uint32_t>(t.flags.size()));
+                fp = decision_cache::hash(bi->long_id(), decision_cache::hash("\n", fp));
+
+                for(const auto& r : bi->rules) {
+                    uint32_t ri = static_cast<uint32_t>(t.flags.size());
+                    uint16_t f = static_cast<uint8_t>(r->loc) & LocationMask;
+                    f |= (static_cast<uint8_t>(r->scope) << ScopeShift) & ScopeMask;
+                    if(r->type == match_type::regex) f |= RegexBit;
+                    if(r->type == match_type::glob) f |= GlobBit;
+                    if(r->type == match_type::exact && r->loc != match_location::lua_script) {
+                        f |= ExactBit;
+                        if(!r->get_folded_value().empty()) {
+                            t.exact[static_cast<size_t>(matching::part_of(r->loc, r->scope))][r->get_folded_value()].push_back(ri);
+                        }
+                    }
+                    if(r->app_mode) f |= AppModeBit;
+                    if(r->is_ascii()) f |= AsciiBit;
+
+                    t.value.push_back(t.strings.intern(matching::needle_of(*r)));
+                    t.flags.push_back(f);
+                    t.priority.push_back(r->priority);
+                    t.matchers.push_back(matching::get_matcher(*r));
+
+                    uint32_t slot = matching::rule_ref::NoSlot;
+                    if(r->type == match_type::regex && r->loc != match_location::lua_script && r->get_linear_regex()) {
+                        auto& p = patterns[static_cast<size_t>(matching::part_of(r->loc, r->scope))];
+                        slot = static_cast<uint32_t>(p.size());
+                        p.push_back(r->value);
+                    }
+                    t.regex_slot.push_back(slot);
+
+                    t.predicate.push_back(r->get_expression()
+                        ? t.predicates.add(r->value)
+                        : matching::rule_ref::NoSlot);
+
+                    if(r->loc == match_location::lua_script) {
+                        t.cacheable = false;
+                        t.lua_rules.push_back(static_cast<uint32_t>(t.flags.size() - 1));
+                    } else if(r->type == match_type::expr) {
+                        if(r->get_expression()) t.input_parts |= r->get_expression()->get_input_parts();
+                    } else if(r->type == match_type::list) {
+                        // list contents are identified by the compiled table, whose name changes with the source
+                        t.input_parts |= 1u << static_cast<uint32_t>(matching::input_part::host);
+                        if(r->get_domain_list()) {
+                            fp = decision_cache::hash(r->get_domain_list()->get_table_path(), fp);
+                        } else {
+                            t.cacheable = false;
+                        }
+                    } else {
+                        t.input_parts |= 1u << static_cast<uint32_t>(matching::part_of(r->loc, r->scope));
+                    }
+                    fp = decision_cache::hash(r->to_line(), decision_cache::hash("\t", fp));
+
+                    // snapshot, so that editing rules in the UI can't race with or invalidate the table
+                    t.source.push_back(make_shared<const match_rule>(*r));
+                }
+            }
+        }
+        t.first_rule.push_back(static_cast<uint32_t>(t.flags.size()));
+
+        // one automaton per input part, so that all regex rules looking at it are evaluated in a single pass
+        for(size_t i = 0; i < patterns.size(); i++) {
+            if(patterns[i].empty()) continue;
+            t.regexes.sets[i] = matching::linear_regex::compile(patterns[i]);
+        }
+
+        // too big to be combined, rules of this part are matched one by one
+        for(uint32_t ri = 0; ri < t.regex_slot.size(); ri++) {
+            if(t.regex_slot[ri] == matching::rule_ref::NoSlot) continue;
+            const match_rule& r = *t.source[ri];
+            if(!t.regexes.sets[static_cast<size_t>(matching::part_of(r.loc, r.scope))]) {
+                t.regex_slot[ri] = matching::rule_ref::NoSlot;
+            }
+        }
+
+        t.fingerprint = fp;
+        return t;
+    }
+
+    std::uint64_t rule_table::key_of(const click_payload& up) const {
+        auto ctx = matching::match_context::of(up, nullptr);
+        const array<string_view, matching::InputPartCount> parts{ctx.url, ctx.host, ctx.path, ctx.title, ctx.process};
+
+        // parts no rule looks at don't affect the decision, e.g. window title is irrelevant without title rules
+        uint64_t h = decision_cache::HashBasis;
+        for(uint32_t i = 0; i < parts.size(); i++) {
+            h = decision_cache::hash("\n", h);
+            if(input_parts & (1u << i)) h = decision_cache::hash(parts[i], h);
+        }
+        return h;
+    }
+
+    std::pmr::vector<rule_table::hit> rule_table::match(const click_payload& up, const script_site& script,
+        std::pmr::memory_resource* mem) const {
+        pmr::vector<hit> r{mem};
+
+        // extract everything rules can look at once per click, instead of once per rule
+        auto ctx = matching::match_context::of(up, &script, mem);
+        matching::regex_batch_results regex_results{regexes, mem};
+        ctx.regexes = &regex_results;
+        matching::predicate_results predicate_results{predicates, mem};
+        ctx.predicates = &predicate_results;
+
+        pmr::vector<uint32_t> exact_hits = find_exact(ctx, mem);
+
+        if(flags.size() >= parallel_threshold && instances.size() > 0) {
+            match_parallel(ctx, exact_hits, r);
+        } else {
+            for(uint32_t i = 0; i < instances.size(); i++) {
+                uint32_t exact_stop = get_exact_stop(i, exact_hits);
+                for(uint32_t ri = first_rule[i]; ri < exact_stop; ri++) {
+                    if(test(ri, ctx)) {
+                        exact_stop = ri;
+                        break;
+                    }
+                }
+                if(exact_stop < first_rule[i + 1]) r.emplace_back(exact_stop, i);
+            }
+        }
+
+        if(r.size() > 1) {
+            std::stable_sort(r.begin(), r.end(), [this](const hit& a, const hit& b) {
+                return priority[a.rule] > priority[b.rule];
+            });
+        }
+
+        return r;
+    }
+
+    std::pmr::vector<std::uint32_t> rule_table::find_exact(const matching::match_context& ctx,
+        std::pmr::memory_resource* mem) const {
+        pmr::vector<uint32_t> hits{mem};
+
+        // exact rules are looked up by the input instead of being compared one by one
+        const array<string_view, matching::InputPartCount> parts{ctx.url, ctx.host, ctx.path, ctx.title, ctx.process};
+        for(size_t p = 0; p < parts.size(); p++) {
+            if(exact[p].empty() || parts[p].empty()) continue;
+
+            pmr::string folded{parts[p], mem};
+            for(char& c : folded) {
+                if(c >= 'A' && c <= 'Z') c |= 0x20;
+            }
+            auto it = exact[p].find(string_view{folded});
+            if(it != exact[p].end()) hits.insert(hits.end(), it->second.begin(), it->second.end());
+        }
+        if(hits.size() > 1) std::sort(hits.begin(), hits.end());
+
+        return hits;
+    }
+
+    std::uint32_t rule_table::get_exact_stop(std::uint32_t instance,
+        const std::pmr::vector<std::uint32_t>& exact_hits) const {
+        // first exact hit of the profile is its match, unless an earlier rule matches, so nothing after it runs
+        uint32_t end = first_rule[instance + 1];
+        auto eh = lower_bound(exact_hits.begin(), exact_hits.end(), first_rule[instance]);
+        return eh != exact_hits.end() && *eh < end ? *eh : end;
+    }
+
+    bool rule_table::test(std::uint32_t ri, const matching::match_context& ctx) const {
+        // exact rules not found in the index can't match
+        if(flags[ri] & ExactBit) return false;
+
+        return matchers[ri](matching::rule_ref{strings.get(value[ri]), source[ri].get(), regex_slot[ri], predicate[ri]}, ctx);
+    }
+
+    namespace {
+        /**
+         * @brief Matching state of one thread taking part in a parallel match.
+         */
+        struct parallel_worker {
+            // click arena is not thread safe, so each thread has its own
+            std::array<std::byte, 4096> buffer;
+            std::pmr::monotonic_buffer_resource mem{buffer.data(), buffer.size()};
+            matching::match_context ctx;
+            matching::predicate_results predicate_results;
+
+            /**
+             * @param regexes evaluated up front and shared by all threads, read only
+             */
+            parallel_worker(const click_payload& up, const script_site& script,
+                matching::regex_batch_results* regexes, const matching::predicate_dag& predicates)
+                : ctx{matching::match_context::of(up, &script, &mem)},
+                predicate_results{predicates, &mem} {
+                ctx.regexes = regexes;
+                ctx.predicates = &predicate_results;
+            }
+        };
+    }
+
+    void rule_table::match_parallel(const matching::match_context& ctx,
+        const std::pmr::vector<std::uint32_t>& exact_hits, std::pmr::vector<hit>& r) const {
+
+        // lowest matching rule of every profile found so far, first_rule[i + 1] if none. Any thread can lower it.
+        vector<atomic<uint32_t>> first(instances.size());
+        for(uint32_t i = 0; i < instances.size(); i++) {
+            first[i].store(get_exact_stop(i, exact_hits), memory_order_relaxed);
+        }
+
+        // one pass per input part for all regex rules, here, instead of one on every thread taking part
+        ctx.regexes->evaluate_all({ctx.url, ctx.host, ctx.path, ctx.title, ctx.process});
+
+        matching::work_pool& pool = matching::work_pool::get();
+        vector<unique_ptr<parallel_worker>> workers(pool.get_participant_count());
+
+        pool.parallel_for(flags.size(), ParallelChunkSize, [&](size_t participant, size_t begin, size_t end) {
+            auto& w = workers[participant];
+            if(!w) w = make_unique<parallel_worker>(ctx.up, *ctx.script, ctx.regexes, predicates);
+
+            // profile of the first rule in the chunk (the last one starting at or before it, as profiles can be empty)
+            uint32_t i = static_cast<uint32_t>(upper_bound(first_rule.begin(), first_rule.end(), begin) - first_rule.begin()) - 1;
+            for(uint32_t ri = static_cast<uint32_t>(begin); ri < end; ri++) {
+                while(ri >= first_rule[i + 1]) i++;
+
+                // an earlier rule of this profile already matched, so the rest of it can't win
+                if(ri >= first[i].load(memory_order_relaxed)) {
+                    ri = first_rule[i + 1] - 1;
+                    continue;
+                }
+
+                // Lua rules are left to the calling thread, see below
+                if(get_location(ri) == match_location::lua_script) continue;
+
+                if(test(ri, w->ctx)) {
+                    uint32_t current = first[i].load(memory_order_relaxed);
+                    while(ri < current && !first[i].compare_exchange_weak(current, ri, memory_order_relaxed)) {}
+                    ri = first_rule[i + 1] - 1;
+                }
+            }
+        });
+
+        // Lua rules run here, in one state, so that threads don't each hold one of the script's pool. Only those before
+        // the first native match of their profile can change the result, and the first of them to match wins.
+        uint32_t i = 0;
+        for(uint32_t ri : lua_rules) {
+            while(ri >= first_rule[i + 1]) i++;
+            uint32_t stop = first[i].load(memory_order_relaxed);
+            if(ri < stop && test(ri, ctx)) first[i].store(ri, memory_order_relaxed);
+        }
+
+        // same order as a serial match, whichever thread found what
+        for(uint32_t i = 0; i < instances.size(); i++) {
+            uint32_t ri = first[i].load(memory_order_relaxed);
+            if(ri < first_rule[i + 1]) r.emplace_back(ri, i);
+        }
+    }
+}
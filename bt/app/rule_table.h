@@ -0,0 +1,230 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <array>
+#include <functional>
+#include <cstdint>
+#include "match_rule.h"
+#include "click_payload.h"
+#include "script_site.h"
+#include "matching/matcher.h"
+#include "matching/predicate_dag.h"
+
+namespace bt {
+
+    class browser;
+    class browser_instance;
+
+    /**
+     * @brief Interns strings so that equal strings are stored once and referred to by a compact id.
+     */
+    class string_pool {
+    public:
+        std::uint32_t intern(std::string_view s);
+
+        std::string_view get(std::uint32_t id) const { return strings[id]; }
+
+        size_t size() const { return strings.size(); }
+
+    private:
+        // deque never moves elements, so views used as keys stay valid
+        std::deque<std::string> strings;
+        std::unordered_map<std::string_view, std::uint32_t> ids;
+    };
+
+    /**
+     * @brief Hash for unordered containers with string keys that can be looked up by string_view without a copy.
+     */
+    struct string_hash {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+
+    /**
+     * @brief All rules of the configuration in a single flat table, laid out as structure of arrays. Rules of each
+     * profile are stored contiguously, in the same order as in the profile.
+     */
+    class rule_table {
+    public:
+
+        /**
+         * @brief A matched rule, as an index into the table.
+         */
+        struct hit {
+            std::uint32_t rule;
+            std::uint32_t instance;
+        };
+
+        // packed per-rule flags
+        static constexpr std::uint8_t LocationMask  = 0b00000011;
+        static constexpr std::uint8_t ScopeShift    = 2;
+        static constexpr std::uint8_t ScopeMask     = 0b00001100;
+        static constexpr std::uint8_t RegexBit      = 0b00010000;
+        static constexpr std::uint8_t AppModeBit    = 0b00100000;
+        static constexpr std::uint8_t AsciiBit      = 0b01000000;
+        static constexpr std::uint8_t GlobBit       = 0b10000000;
+        static constexpr std::uint16_t ExactBit     = 0b100000000;
+
+        /**
+         * @brief Rule count from which rules are matched in parallel on matching::work_pool. Below it waking up
+         * threads costs more than it saves (see WorkPool.DISABLED_Bench).
+         */
+        static constexpr size_t DefaultParallelThreshold = 8192;
+
+        /**
+         * @brief Rules per unit of work in parallel matching.
+         */
+        static constexpr size_t ParallelChunkSize = 512;
+
+        static rule_table build(const std::vector<std::shared_ptr<browser>>& browsers);
+
+        /**
+         * @brief Finds first matching rule in every profile, ordered by priority (highest first). Profiles with equal
+         * priority keep their configuration order. Large tables are matched in parallel with the same result, except that
+         * rules after the first match of a profile may be evaluated too. Lua rules always run on the calling thread.
+         * @param mem where the result and matcher temporaries are allocated, normally a click_arena
+         */
+        std::pmr::vector<hit> match(const click_payload& up, const script_site& script,
+            std::pmr::memory_resource* mem = std::pmr::get_default_resource()) const;
+
+        size_t rule_count() const { return flags.size(); }
+
+        /**
+         * @brief Matches in parallel from this many rules on, SIZE_MAX to never do it.
+         */
+        void set_parallel_threshold(size_t rules) { parallel_threshold = rules; }
+
+        size_t instance_count() const { return instances.size(); }
+
+        const std::shared_ptr<const match_rule>& get_rule(std::uint32_t idx) const { return source[idx]; }
+
+        const std::shared_ptr<browser_instance>& get_instance(std::uint32_t idx) const { return instances[idx]; }
+
+        match_location get_location(std::uint32_t idx) const {
+            return static_cast<match_location>(flags[idx] & LocationMask);
+        }
+
+        match_scope get_scope(std::uint32_t idx) const {
+            return static_cast<match_scope>((flags[idx] & ScopeMask) >> ScopeShift);
+        }
+
+        int get_priority(std::uint32_t idx) const { return priority[idx]; }
+
+        std::string_view get_value(std::uint32_t idx) const { return strings.get(value[idx]); }
+
+        /**
+         * @brief Identifies rules and profiles the table was built from. Changes whenever anything that affects
+         * matching does, including contents of domain lists.
+         */
+        std::uint64_t get_fingerprint() const { return fingerprint; }
+
+        /**
+         * @brief Whether matching depends on the click alone, so that results can be reused for the same click. Not the
+         * case with Lua rules.
+         */
+        bool is_cacheable() const { return cacheable; }
+
+        /**
+         * @brief Hash of those parts of the click that any rule looks at, see decision_cache.
+         */
+        std::uint64_t key_of(const click_payload& up) const;
+
+    private:
+        // --- per rule
+
+        /**
+         * @brief Interned match value. For plain substring rules this is the folded needle.
+         */
+        std::vector<std::uint32_t> value;
+        std::vector<std::uint16_t> flags;
+        std::vector<int> priority;
+
+        /**
+         * @brief Matcher specialised for the rule's location, scope and kind, bound when the table is built.
+         */
+        std::vector<matching::matcher_fn> matchers;
+
+        /**
+         * @brief Slot in the regex batch, or rule_ref::NoSlot.
+         */
+        std::vector<std::uint32_t> regex_slot;
+
+        /**
+         * @brief Root node in the predicate graph for expression rules, or rule_ref::NoSlot.
+         */
+        std::vector<std::uint32_t> predicate;
+
+        /**
+         * @brief Original rule, used for regex and Lua evaluation and returned to callers. Snapshot, not shared with the UI.
+         */
+        std::vector<std::shared_ptr<const match_rule>> source;
+
+        // --- per profile
+
+        std::vector<std::shared_ptr<browser_instance>> instances;
+
+        /**
+         * @brief Rules of profile i are [first_rule[i], first_rule[i + 1]).
+         */
+        std::vector<std::uint32_t> first_rule;
+
+        string_pool strings;
+
+        /**
+         * @brief All regex rules the linear time engine supports, compiled together per input part.
+         */
+        matching::regex_batch regexes;
+
+        /**
+         * @brief Expressions of all expression rules, sharing common tests and sub-expressions.
+         */
+        matching::predicate_dag predicates;
+
+        /**
+         * @brief Exact rules by folded value, per input part, so that they are found with a single lookup instead of
+         * being compared one by one. Rule indexes are in ascending order.
+         */
+        std::array<std::unordered_map<std::string, std::vector<std::uint32_t>, string_hash, std::equal_to<>>,
+            matching::InputPartCount> exact;
+
+        // --- whole table
+
+        /**
+         * @brief Bit mask of input parts (1 << matching::input_part) rules look at.
+         */
+        std::uint32_t input_parts{0};
+        std::uint64_t fingerprint{0};
+        bool cacheable{true};
+
+        /**
+         * @brief Lua rules, ascending. They need a state from the script's pool, which parallel workers could exhaust
+         * while each holds one, so in a parallel match they are evaluated by the calling thread instead.
+         */
+        std::vector<std::uint32_t> lua_rules;
+        size_t parallel_threshold{DefaultParallelThreshold};
+
+        /**
+         * @brief Exact rules matching the click, ascending.
+         */
+        std::pmr::vector<std::uint32_t> find_exact(const matching::match_context& ctx, std::pmr::memory_resource* mem) const;
+
+        /**
+         * @brief First exact hit in the profile, or the end of its rules. Only rules before it need evaluating.
+         */
+        std::uint32_t get_exact_stop(std::uint32_t instance, const std::pmr::vector<std::uint32_t>& exact_hits) const;
+
+        bool test(std::uint32_t ri, const matching::match_context& ctx) const;
+
+        /**
+         * @param ctx of the calling thread, used for Lua rules
+         */
+        void match_parallel(const matching::match_context& ctx,
+            const std::pmr::vector<std::uint32_t>& exact_hits, std::pmr::vector<hit>& r) const;
+    };
+}
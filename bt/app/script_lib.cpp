@@ -0,0 +1,362 @@
+#include "script_lib.h"
+#include "matching/linear_regex.h"
+#include <regex>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace bt {
+
+    static inline char fold(char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+    }
+
+    static bool equals_ic(string_view a, string_view b) {
+        if(a.size() != b.size()) return false;
+        for(size_t i = 0; i < a.size(); i++) {
+            if(fold(a[i]) != fold(b[i])) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Host without user info, port and trailing dots.
+     */
+    static string_view host_of(string_view url) {
+        string_view host = script_lib::split_url(url).host;
+        size_t at = host.rfind('@');
+        if(at != string_view::npos) host = host.substr(at + 1);
+        host = host.substr(0, host.find(':'));
+        while(host.ends_with('.')) host.remove_suffix(1);
+        return host;
+    }
+
+    static int hex_value(char c) {
+        if(c >= '0' && c <= '9') return c - '0';
+        if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    namespace {
+        /**
+         * @brief url split into what comes before the query, query parameters, and fragment (with "#").
+         */
+        struct query_edit {
+            string_view base;
+            vector<string_view> pairs;
+            string_view fragment;
+
+            explicit query_edit(string_view url) {
+                size_t hash = url.find('#');
+                if(hash != string_view::npos) {
+                    fragment = url.substr(hash);
+                    url = url.substr(0, hash);
+                }
+
+                size_t q = url.find('?');
+                base = url.substr(0, q);
+                if(q == string_view::npos) return;
+
+                string_view query = url.substr(q + 1);
+                while(!query.empty()) {
+                    size_t amp = query.find('&');
+                    string_view pair = query.substr(0, amp);
+                    if(!pair.empty()) pairs.push_back(pair);
+                    if(amp == string_view::npos) break;
+                    query.remove_prefix(amp + 1);
+                }
+            }
+
+            static bool is_named(string_view pair, string_view name) {
+                return script_lib::url_decode(pair.substr(0, pair.find('=')), true) == name;
+            }
+
+            string to_url() const {
+                string r{base};
+                for(size_t i = 0; i < pairs.size(); i++) {
+                    r += i == 0 ? '?' : '&';
+                    r += pairs[i];
+                }
+                r += fragment;
+                return r;
+            }
+        };
+    }
+
+    script_lib::url_parts script_lib::split_url(std::string_view url) {
+        url_parts r;
+
+        const string_view prot_end("://");
+        size_t idx = url.find(prot_end);
+        if(idx != string_view::npos) {
+            r.scheme = url.substr(0, idx);
+            url = url.substr(idx + prot_end.size());
+        }
+
+        idx = url.find('#');
+        if(idx != string_view::npos) url = url.substr(0, idx);
+
+        idx = url.find('?');
+        if(idx != string_view::npos) {
+            r.query = url.substr(idx + 1);
+            url = url.substr(0, idx);
+        }
+
+        idx = url.find('/');
+        r.host = url.substr(0, idx);
+        if(idx != string_view::npos) r.path = url.substr(idx);
+
+        return r;
+    }
+
+    bool script_lib::host_is(std::string_view url, std::string_view domain) {
+        return equals_ic(host_of(url), domain);
+    }
+
+    bool script_lib::host_ends(std::string_view url, std::string_view domain) {
+        string_view host = host_of(url);
+        if(host.size() == domain.size()) return equals_ic(host, domain);
+        return host.size() > domain.size() &&
+            host[host.size() - domain.size() - 1] == '.' &&
+            equals_ic(host.substr(host.size() - domain.size()), domain);
+    }
+
+    std::string script_lib::url_decode(std::string_view s, bool plus_is_space) {
+        string r;
+        r.reserve(s.size());
+        for(size_t i = 0; i < s.size(); i++) {
+            if(s[i] == '%' && i + 2 < s.size() && hex_value(s[i + 1]) >= 0 && hex_value(s[i + 2]) >= 0) {
+                r += static_cast<char>(hex_value(s[i + 1]) * 16 + hex_value(s[i + 2]));
+                i += 2;
+            } else if(s[i] == '+' && plus_is_space) {
+                r += ' ';
+            } else {
+                r += s[i];
+            }
+        }
+        return r;
+    }
+
+    std::string script_lib::url_encode(std::string_view s) {
+        static const char* Hex = "0123456789ABCDEF";
+        string r;
+        r.reserve(s.size());
+        for(char c : s) {
+            if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                c == '-' || c == '.' || c == '_' || c == '~') {
+                r += c;
+            } else {
+                unsigned char b = static_cast<unsigned char>(c);
+                r += '%';
+                r += Hex[b >> 4];
+                r += Hex[b & 0xF];
+            }
+        }
+        return r;
+    }
+
+    std::optional<std::string> script_lib::qs_get(std::string_view url, std::string_view name) {
+        query_edit q{url};
+        for(string_view pair : q.pairs) {
+            if(!query_edit::is_named(pair, name)) continue;
+            size_t eq = pair.find('=');
+            return eq == string_view::npos ? string{} : url_decode(pair.substr(eq + 1), true);
+        }
+        return nullopt;
+    }
+
+    std::string script_lib::qs_set(std::string_view url, std::string_view name, std::string_view value) {
+        query_edit q{url};
+        string pair = url_encode(name) + "=" + url_encode(value);
+
+        // first occurrence is replaced, repeats are dropped
+        bool set{false};
+        vector<string_view> pairs;
+        for(string_view p : q.pairs) {
+            if(!query_edit::is_named(p, name)) {
+                pairs.push_back(p);
+            } else if(!set) {
+                pairs.push_back(pair);
+                set = true;
+            }
+        }
+        if(!set) pairs.push_back(pair);
+        q.pairs = std::move(pairs);
+
+        return q.to_url();
+    }
+
+    std::string script_lib::qs_remove(std::string_view url, std::string_view name) {
+        query_edit q{url};
+        erase_if(q.pairs, [name](string_view p) { return query_edit::is_named(p, name); });
+        return q.to_url();
+    }
+
+    // --- regex cache
+
+    namespace {
+        struct cached_regex {
+            shared_ptr<const matching::linear_regex> linear;
+            shared_ptr<const regex> fallback;
+        };
+    }
+
+    static mutex regex_cache_mutex;
+    static unordered_map<string, cached_regex> regex_cache;
+
+    bool script_lib::regex_match(std::string_view input, const std::string& pattern, std::string* error) {
+        cached_regex re;
+        {
+            lock_guard<mutex> lock{regex_cache_mutex};
+            auto it = regex_cache.find(pattern);
+            if(it != regex_cache.end()) re = it->second;
+        }
+
+        if(!re.linear && !re.fallback) {
+            // same engines and options as regex rules (see match_rule::compile)
+            re.linear = matching::linear_regex::compile(pattern);
+            if(!re.linear) {
+                try {
+                    re.fallback = make_shared<const regex>(pattern, regex_constants::icase);
+                } catch(const regex_error& e) {
+                    if(error) *error = e.what();
+                    return false;
+                }
+            }
+
+            lock_guard<mutex> lock{regex_cache_mutex};
+            if(regex_cache.size() >= MaxCachedRegexes) regex_cache.clear();
+            regex_cache.emplace(pattern, re);
+        }
+
+        return re.linear
+            ? re.linear->match(input)
+            : std::regex_match(input.begin(), input.end(), *re.fallback);
+    }
+
+    size_t script_lib::get_cached_regex_count() {
+        lock_guard<mutex> lock{regex_cache_mutex};
+        return regex_cache.size();
+    }
+
+    // --- Lua bindings
+
+    static string_view check_string(lua_State* L, int arg) {
+        size_t len{0};
+        const char* s = luaL_checklstring(L, arg, &len);
+        return string_view{s, len};
+    }
+
+    static void push_string(lua_State* L, string_view s) {
+        lua_pushlstring(L, s.data(), s.size());
+    }
+
+    void script_lib::push_params(lua_State* L, std::string_view query) {
+        // name -> decoded value, the last one wins when a name repeats
+        lua_newtable(L);
+        while(!query.empty()) {
+            size_t amp = query.find('&');
+            string_view pair = query.substr(0, amp);
+            if(!pair.empty()) {
+                size_t eq = pair.find('=');
+                string name = url_decode(pair.substr(0, eq), true);
+                string value = eq == string_view::npos ? string{} : url_decode(pair.substr(eq + 1), true);
+                push_string(L, value);
+                lua_setfield(L, -2, name.c_str());
+            }
+            if(amp == string_view::npos) break;
+            query.remove_prefix(amp + 1);
+        }
+    }
+
+    static int lua_host_is(lua_State* L) {
+        lua_pushboolean(L, script_lib::host_is(check_string(L, 1), check_string(L, 2)));
+        return 1;
+    }
+
+    static int lua_host_ends(lua_State* L) {
+        lua_pushboolean(L, script_lib::host_ends(check_string(L, 1), check_string(L, 2)));
+        return 1;
+    }
+
+    static int lua_url_parse(lua_State* L) {
+        script_lib::url_parts u = script_lib::split_url(check_string(L, 1));
+        lua_createtable(L, 0, 5);
+        push_string(L, u.scheme);
+        lua_setfield(L, -2, "scheme");
+        push_string(L, u.host);
+        lua_setfield(L, -2, "host");
+        push_string(L, u.path);
+        lua_setfield(L, -2, "path");
+        push_string(L, u.query);
+        lua_setfield(L, -2, "query");
+
+        script_lib::push_params(L, u.query);
+        lua_setfield(L, -2, "params");
+        return 1;
+    }
+
+    static int lua_qs_get(lua_State* L) {
+        optional<string> v = script_lib::qs_get(check_string(L, 1), check_string(L, 2));
+        if(v) push_string(L, *v);
+        else lua_pushnil(L);
+        return 1;
+    }
+
+    static int lua_qs_set(lua_State* L) {
+        push_string(L, script_lib::qs_set(check_string(L, 1), check_string(L, 2), check_string(L, 3)));
+        return 1;
+    }
+
+    static int lua_qs_remove(lua_State* L) {
+        push_string(L, script_lib::qs_remove(check_string(L, 1), check_string(L, 2)));
+        return 1;
+    }
+
+    static int lua_url_decode(lua_State* L) {
+        push_string(L, script_lib::url_decode(check_string(L, 1)));
+        return 1;
+    }
+
+    static int lua_regex_match(lua_State* L) {
+        // luaL_check* and lua_error jump out with longjmp, so C++ objects must be gone by then
+        string_view input = check_string(L, 1);
+        string_view pattern = check_string(L, 2);
+        {
+            string error;
+            bool r = script_lib::regex_match(input, string{pattern}, &error);
+            if(error.empty()) {
+                lua_pushboolean(L, r);
+                return 1;
+            }
+            lua_pushfstring(L, "invalid pattern: %s", error.c_str());
+        }
+        return lua_error(L);
+    }
+
+    static const luaL_Reg functions[] = {
+        {"host_is", lua_host_is},
+        {"host_ends", lua_host_ends},
+        {"url_parse", lua_url_parse},
+        {"qs_get", lua_qs_get},
+        {"qs_set", lua_qs_set},
+        {"qs_remove", lua_qs_remove},
+        {"url_decode", lua_url_decode},
+        {"regex_match", lua_regex_match},
+        {nullptr, nullptr}
+    };
+
+    static int open_module(lua_State* L) {
+        luaL_newlib(L, functions);
+        return 1;
+    }
+
+    void script_lib::open(lua_State* L) {
+        luaL_requiref(L, "bt", open_module, 1);
+        lua_pop(L, 1);
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "lua.hpp"
+#include <string>
+#include <string_view>
+#include <optional>
+
+namespace bt {
+
+    /**
+     * @brief Native "bt" module available to Lua scripts, for the things scripts otherwise do in slow, hand-rolled Lua:
+     *
+     * - `bt.host_is(url, domain)`: host of url (or a bare host) is domain, ignoring case, port and user info.
+     * - `bt.host_ends(url, domain)`: same, or host is a subdomain of domain.
+     * - `bt.url_parse(url)`: table with scheme, host, path, query and params, same as the fields of "p".
+     * - `bt.qs_get(url, name)`: decoded value of query parameter, nil if there is none.
+     * - `bt.qs_set(url, name, value)`: url with parameter set to value, added if missing.
+     * - `bt.qs_remove(url, name)`: url without parameter.
+     * - `bt.url_decode(s)`: percent-decoded s.
+     * - `bt.regex_match(s, pattern)`: whether pattern matches the whole of s, ignoring case, as regex rules do.
+     *   Compiled patterns are cached.
+     *
+     * Functions the module is built on are exposed for C++ use and testing.
+     */
+    class script_lib {
+    public:
+        struct url_parts {
+            std::string_view scheme;
+            std::string_view host;
+            std::string_view path;      // with leading "/"
+            std::string_view query;     // without "?"
+        };
+
+        /**
+         * @brief Maximum number of compiled patterns kept for regex_match. The cache is emptied when it's full.
+         */
+        static constexpr size_t MaxCachedRegexes = 256;
+
+        /**
+         * @brief Registers the module in the state, as global "bt" and for require("bt").
+         */
+        static void open(lua_State* L);
+
+        /**
+         * @brief Pushes a table of query parameters (name -> decoded value) onto the Lua stack.
+         */
+        static void push_params(lua_State* L, std::string_view query);
+
+        /**
+         * @brief Splits url the same way rules see it (see matching::match_context::of), additionally taking query and
+         * fragment off host and path.
+         */
+        static url_parts split_url(std::string_view url);
+
+        static bool host_is(std::string_view url, std::string_view domain);
+        static bool host_ends(std::string_view url, std::string_view domain);
+
+        /**
+         * @brief Decodes %XX sequences, and "+" to space if plus_is_space is set (as in query strings).
+         */
+        static std::string url_decode(std::string_view s, bool plus_is_space = false);
+
+        /**
+         * @brief Percent-encodes everything except unreserved characters (RFC 3986).
+         */
+        static std::string url_encode(std::string_view s);
+
+        static std::optional<std::string> qs_get(std::string_view url, std::string_view name);
+        static std::string qs_set(std::string_view url, std::string_view name, std::string_view value);
+        static std::string qs_remove(std::string_view url, std::string_view name);
+
+        /**
+         * @param error set if the pattern is invalid
+         */
+        static bool regex_match(std::string_view input, const std::string& pattern, std::string* error = nullptr);
+
+        /**
+         * @brief Number of patterns in the regex_match cache, for tests and diagnostics.
+         */
+        static size_t get_cached_regex_count();
+    };
+}
@@ -1,21 +1,33 @@
 #include "script_site.h"
+#include "script_lib.h"
 #include <fstream>
-#include <regex>
+#include <filesystem>
+#include <thread>
+#include <algorithm>
+#include <string_view>
+#include <cstdio>
+#include <cstdlib>
 #include "../globals.h"
 
 using namespace std;
+namespace fs = std::filesystem;
 
 namespace bt {
 
+    /**
+     * @brief Identifies chunk cache files, bump when the layout changes.
+     */
+    static const uint32_t ChunkCacheMagic = 0x31434C42;    // "BLC1"
+
     script_site::script_site(const string& path_or_code, bool is_path) :
-        path_or_code{path_or_code}, is_path{is_path} {
+        path_or_code{path_or_code}, is_path{is_path}, current{make_shared<program>()},
+        pool_size{max<size_t>(1, thread::hardware_concurrency())} {
         reload();
     }
 
     script_site::~script_site() {
-        if(L) {
-            lua_close(L);
-        }
+        lock_guard<mutex> lock{pool_mutex};
+        close_idle();
     }
 
     static int lua_print(lua_State* L) {
@@ -54,45 +66,397 @@ namespace bt {
     }
 
 
+    /**
+     * @brief Registry name of the metatable of "p".
+     */
+    static const char* ClickMetatable = "bt.click";
+
+    static void set_string(lua_State* L, const char* name, string_view value) {
+        lua_pushlstring(L, value.data(), value.size());
+        lua_setfield(L, -2, name);
+    }
+
+    /**
+     * @brief __index of "p". URL fields are only worked out when a script first asks for one, then stored in the table
+     * itself, so later reads don't come here.
+     */
+    static int lua_click_index(lua_State* L) {
+        if(lua_type(L, 2) != LUA_TSTRING) return 0;
+        string_view key = lua_tostring(L, 2);
+        bool is_part = key == "scheme" || key == "host" || key == "path" || key == "query";
+        if(!is_part && key != "params") return 0;
+
+        lua_getfield(L, 1, "url");
+        size_t len{0};
+        const char* s = lua_tolstring(L, -1, &len);
+        script_lib::url_parts u = script_lib::split_url(s ? string_view{s, len} : string_view{});
+
+        lua_pushvalue(L, 1);
+        if(is_part) {
+            set_string(L, "scheme", u.scheme);
+            set_string(L, "host", u.host);
+            set_string(L, "path", u.path);
+            set_string(L, "query", u.query);
+        } else {
+            script_lib::push_params(L, u.query);
+            lua_setfield(L, -2, "params");
+        }
+        lua_pop(L, 2);
+
+        lua_rawget(L, 1);
+        return 1;
+    }
+
+    static int write_chunk(lua_State* L, const void* p, size_t sz, void* ud) {
+        static_cast<string*>(ud)->append(static_cast<const char*>(p), sz);
+        return 0;
+    }
+
+    std::string script_site::read_code() const {
+        if(!is_path) return path_or_code;
+
+        ifstream fs(path_or_code);
+        return fs.is_open() ? string(istreambuf_iterator<char>(fs), istreambuf_iterator<char>()) : "";
+    }
+
     void script_site::reload() {
-        error.clear();
-        print_buffer.clear();
+        load(read_code());
+    }
+
+    bool script_site::reload_if_changed() {
+        string code = read_code();
+        if(code == get_program()->code) return false;
+        load(std::move(code));
+        return true;
+    }
+
+    void script_site::load(std::string code) {
+        clear_print_buffer();
+
+        // built aside while clicks keep being evaluated with the current program
+        auto p = make_shared<program>();
+        p->code = std::move(code);
+        string load_error;
+        lua_State* L{nullptr};
+
+        // warm start: chunk and function names saved by an earlier load of the same code
+        p->from_cache = load_cache(*p);
+        if(p->from_cache || compile(*p, load_error)) {
+            // first state runs the chunk now, to report errors and print output straight away
+            L = new_state(p->bytecode, &load_error);
+            if(L && !p->from_cache) {
+                set_function_names(*p, discover_function_names(L));
+
+                // a chunk failing half way may define different functions next time
+                if(load_error.empty()) save_cache(*p);
+            }
+        }
 
-        // reinintialise interpreter
-        if(L) {
+        {
+            lock_guard<mutex> lock{pool_mutex};
+            current = std::move(p);
+            set_error(load_error);
+
+            // states with the previous code are closed, leased ones when they are returned
+            generation++;
+            close_idle();
+
+            if(L) {
+                apply_gc(L);
+                idle.push_back(L);
+                state_count++;
+            }
+        }
+        pool_returned.notify_all();
+    }
+
+    std::shared_ptr<const script_site::program> script_site::get_program() const {
+        lock_guard<mutex> lock{pool_mutex};
+        return current;
+    }
+
+    std::vector<std::string> script_site::get_function_names() const {
+        return get_program()->all_function_names;
+    }
+
+    std::vector<std::string> script_site::get_bt_function_names() const {
+        return get_program()->bt_function_names;
+    }
+
+    std::vector<std::string> script_site::get_ppl_function_names() const {
+        return get_program()->ppl_function_names;
+    }
+
+    std::vector<std::string> script_site::get_rule_function_names() const {
+        return get_program()->rule_function_names;
+    }
+
+    std::string script_site::get_code() const {
+        return get_program()->code;
+    }
+
+    bool script_site::is_from_cache() const {
+        return get_program()->from_cache;
+    }
+
+    std::string script_site::get_error() const {
+        lock_guard<mutex> lock{error_mutex};
+        return error;
+    }
+
+    void script_site::set_error(const std::string& e) {
+        lock_guard<mutex> lock{error_mutex};
+        error = e;
+    }
+
+    bool script_site::compile(program& p, std::string& error) const {
+        // compile once, other states load the same chunk without parsing the source again
+        lua_State* L = lua_newstate(lua_alloc, const_cast<script_site*>(this));
+        if(luaL_loadstring(L, p.code.c_str())) {
+            error = lua_tostring(L, -1);
             lua_close(L);
-            L = nullptr;
+            return false;
+        }
+        lua_dump(L, write_chunk, &p.bytecode, 0);
+        lua_close(L);
+        return true;
+    }
+
+    static uint64_t hash_code(string_view s) {
+        // FNV-1a
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for(char c : s) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    std::string script_site::get_cache_path() const {
+        return is_path ? path_or_code + ".cache" : "";
+    }
+
+    bool script_site::load_cache(program& p) const {
+        string path = get_cache_path();
+        if(path.empty()) return false;
+
+        ifstream in{path, ios::binary};
+        if(!in) return false;
+
+        // magic, Lua version, code hash, bytecode hash, name count, (length, name)..., bytecode
+        uint32_t magic{0}, version{0}, count{0};
+        uint64_t hash{0}, chunk_hash{0};
+        in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+        in.read(reinterpret_cast<char*>(&version), sizeof(version));
+        in.read(reinterpret_cast<char*>(&hash), sizeof(hash));
+        in.read(reinterpret_cast<char*>(&chunk_hash), sizeof(chunk_hash));
+        in.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if(!in || magic != ChunkCacheMagic || version != LUA_VERSION_NUM || hash != hash_code(p.code)) return false;
+
+        vector<string> names;
+        for(uint32_t i = 0; i < count; i++) {
+            uint32_t length{0};
+            in.read(reinterpret_cast<char*>(&length), sizeof(length));
+            if(!in || length > p.code.size()) return false;
+            string name(length, '\0');
+            in.read(name.data(), length);
+            names.push_back(std::move(name));
+        }
+
+        // Lua doesn't check bytecode it loads, so it must be exactly what was saved
+        string chunk{istreambuf_iterator<char>(in), istreambuf_iterator<char>()};
+        if(chunk.empty() || hash_code(chunk) != chunk_hash) return false;
+
+        p.bytecode = std::move(chunk);
+        set_function_names(p, std::move(names));
+        return true;
+    }
+
+    void script_site::save_cache(const program& p) const {
+        string path = get_cache_path();
+        if(path.empty()) return;
+
+        // write to a temporary file and rename, so that a cache is never seen half-written
+        string tmp_path = path + ".tmp";
+        {
+            ofstream out{tmp_path, ios::binary | ios::trunc};
+            if(!out) return;
+
+            uint32_t magic{ChunkCacheMagic}, version{LUA_VERSION_NUM};
+            uint32_t count = static_cast<uint32_t>(p.all_function_names.size());
+            uint64_t hash = hash_code(p.code), chunk_hash = hash_code(p.bytecode);
+            out.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+            out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+            out.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+            out.write(reinterpret_cast<const char*>(&chunk_hash), sizeof(chunk_hash));
+            out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+            for(const string& name : p.all_function_names) {
+                uint32_t length = static_cast<uint32_t>(name.size());
+                out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+                out.write(name.data(), name.size());
+            }
+            out.write(p.bytecode.data(), p.bytecode.size());
+            if(!out) return;
+        }
+
+        error_code ec;
+        fs::rename(tmp_path, path, ec);
+        if(ec) fs::remove(tmp_path, ec);
+    }
+
+    static int lua_panic(lua_State* L) {
+        // same as luaL_newstate's handler, Lua aborts when this returns
+        const char* msg = lua_tostring(L, -1);
+        fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", msg ? msg : "error object is not a string");
+        return 0;
+    }
+
+    void* script_site::lua_alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+        const script_site* site = static_cast<const script_site*>(ud);
+
+        // without ptr, osize is the kind of object being created rather than a size
+        size_t old_size = ptr ? osize : 0;
+
+        if(nsize == 0) {
+            free(ptr);
+            site->heap_bytes.fetch_sub(old_size, memory_order_relaxed);
+            return nullptr;
+        }
+
+        void* r = realloc(ptr, nsize);
+        if(!r) return nullptr;
+
+        // unsigned wrap-around makes shrinking work too
+        size_t now = site->heap_bytes.fetch_add(nsize - old_size, memory_order_relaxed) + (nsize - old_size);
+        size_t peak = site->heap_peak.load(memory_order_relaxed);
+        while(now > peak && !site->heap_peak.compare_exchange_weak(peak, now, memory_order_relaxed)) {}
+        return r;
+    }
+
+    void script_site::apply_gc(lua_State* L) const {
+        // 0 leaves a parameter as it is
+        if(gc == gc_mode::generational) {
+            lua_gc(L, LUA_GCGEN, 0, 0);
+        } else {
+            lua_gc(L, LUA_GCINC, 0, 0, gc_step_size);
         }
+    }
+
+    void script_site::set_gc(gc_mode mode, int step_size) {
+        lock_guard<mutex> lock{pool_mutex};
+        gc = mode;
+        gc_step_size = max(0, step_size);
+        for(lua_State* L : idle) apply_gc(L);
+    }
+
+    script_site::gc_mode script_site::get_gc_mode() const {
+        lock_guard<mutex> lock{pool_mutex};
+        return gc;
+    }
 
-        L = luaL_newstate();
+    int script_site::get_gc_step_size() const {
+        lock_guard<mutex> lock{pool_mutex};
+        return gc_step_size;
+    }
+
+    lua_State* script_site::new_state(const std::string& bytecode, std::string* error) const {
+        lua_State* L = lua_newstate(lua_alloc, const_cast<script_site*>(this));
+        if(!L) return nullptr;
+        lua_atpanic(L, lua_panic);
         luaL_openlibs(L);
 
         // Register the custom print function
-        lua_pushlightuserdata(L, this);
+        lua_pushlightuserdata(L, const_cast<script_site*>(this));
         lua_pushcclosure(L, lua_print, 1);
         lua_setglobal(L, "print");
 
-        // load code into string
-        {
-            if(is_path) {
-                ifstream fs(path_or_code);
-                if(fs.is_open()) {
-                    code = string(istreambuf_iterator<char>(fs), istreambuf_iterator<char>());
+        script_lib::open(L);
+
+        // metatable of "p", set by lease::push
+        luaL_newmetatable(L, ClickMetatable);
+        lua_pushcfunction(L, lua_click_index);
+        lua_setfield(L, -2, "__index");
+        lua_pop(L, 1);
+
+        if(luaL_loadbufferx(L, bytecode.data(), bytecode.size(), "script", "b")) {
+            lua_close(L);
+            return nullptr;
+        }
+
+        // a runtime error leaves whatever was defined before it usable, as it always did
+        if(lua_pcall(L, 0, 0, 0)) {
+            if(error) {
+                const char* e = lua_tostring(L, -1);
+                *error = e ? e : "error";
+            }
+            lua_pop(L, 1);
+        }
+
+        return L;
+    }
+
+    void script_site::close_idle() {
+        for(lua_State* L : idle) {
+            lua_close(L);
+        }
+        state_count -= idle.size();
+        idle.clear();
+    }
+
+    script_site::lease script_site::acquire() const {
+        unique_lock<mutex> lock{pool_mutex};
+
+        while(true) {
+            if(!idle.empty()) {
+                lua_State* L = idle.back();
+                idle.pop_back();
+                return lease{this, L, generation};
+            }
+
+            // script failed to load
+            if(current->bytecode.empty()) return {};
+
+            if(state_count < pool_size) {
+                // reserve a slot and run the chunk without holding the pool, it's user code and may take a while
+                state_count++;
+                shared_ptr<const program> p = current;
+                uint64_t g = generation;
+                lock.unlock();
+                lua_State* L = new_state(p->bytecode);
+                lock.lock();
+
+                if(!L) {
+                    state_count--;
+                    lock.unlock();
+                    pool_returned.notify_one();
+                    return {};
                 }
-            } else {
-                code = path_or_code;
+
+                // a reload meanwhile makes it an old generation state, closed when returned
+                apply_gc(L);
+                return lease{this, L, g};
             }
+
+            pool_returned.wait(lock);
         }
+    }
 
-        discover_function_names();
+    size_t script_site::get_pool_size() const {
+        lock_guard<mutex> lock{pool_mutex};
+        return pool_size;
+    }
 
-        // load code into interpreter
-        if(luaL_loadstring(L, code.c_str()) || lua_pcall(L, 0, 0, 0)) {
-            error = lua_tostring(L, -1);
-            // pop error message from the stack
-            lua_pop(L, 1);
-            return;
+    void script_site::set_pool_size(size_t size) {
+        {
+            lock_guard<mutex> lock{pool_mutex};
+            pool_size = max<size_t>(1, size);
         }
+        pool_returned.notify_all();
+    }
+
+    size_t script_site::get_state_count() const {
+        lock_guard<mutex> lock{pool_mutex};
+        return state_count;
     }
 
     void script_site::set_code(const std::string& code) {
@@ -110,15 +474,78 @@ namespace bt {
     }
 
     bool script_site::call_rule(const click_payload& up, const string& function_name) {
+        lease l = acquire();
+        if(!l) return false;
+
+        string e;
+        bool r = l.call_rule(up, function_name, &e);
+        if(!e.empty()) set_error(e);
+        return r;
+    }
+
+    std::string script_site::call_ppl(const click_payload& up, const std::string& function_name) {
+        lease l = acquire();
+        if(!l) return up.url;
+
+        string e;
+        string r = l.call_ppl(up, function_name, &e);
+        if(!e.empty()) set_error(e);
+        return r;
+    }
+
+    script_site::lease::lease(lease&& other) noexcept
+        : site{other.site}, L{other.L}, generation{other.generation} {
+        other.L = nullptr;
+    }
+
+    script_site::lease& script_site::lease::operator=(lease&& other) noexcept {
+        if(this != &other) {
+            release();
+            site = other.site;
+            L = other.L;
+            generation = other.generation;
+            other.L = nullptr;
+        }
+        return *this;
+    }
+
+    script_site::lease::~lease() {
+        release();
+    }
+
+    void script_site::lease::release() {
+        if(!L) return;
+
+        {
+            lock_guard<mutex> lock{site->pool_mutex};
+            if(generation == site->generation) {
+                lua_settop(L, 0);
+                // in case settings changed while it was leased, cheap when they didn't
+                site->apply_gc(L);
+                site->idle.push_back(L);
+            } else {
+                // code was reloaded meanwhile
+                lua_close(L);
+                site->state_count--;
+            }
+        }
+        site->pool_returned.notify_one();
+        L = nullptr;
+    }
+
+    bool script_site::lease::call_rule(const click_payload& up, const string& function_name, string* error) {
 
         // set global table "p" with 3 members: url, window_title, process_name
-        lua_push(up);
+        push(up);
 
         // call function
         lua_getglobal(L, function_name.c_str());
         if(lua_pcall(L, 0, 1, 0)) {
             // get error message from the stack
-            error = lua_tostring(L, -1);
+            if(error) {
+                const char* e = lua_tostring(L, -1);
+                *error = e ? e : "error";
+            }
             lua_pop(L, 1);
             return false;
         }
@@ -127,23 +554,20 @@ namespace bt {
         bool r = lua_toboolean(L, -1);
         lua_pop(L, 1);
 
-        // read back "url" from global table "p" (in case it's changed)
-        //lua_getglobal(L, "p");
-        //lua_getfield(L, -1, "url");
-        //up.match_url = lua_tostring(L, -1);
-        //lua_pop(L, 1);
-
         return r;
     }
 
-    std::string script_site::call_ppl(const click_payload& up, const std::string& function_name) {
-        lua_push(up);
+    std::string script_site::lease::call_ppl(const click_payload& up, const std::string& function_name, string* error) {
+        push(up);
 
         // call function
         lua_getglobal(L, function_name.c_str());
         if(lua_pcall(L, 0, 1, 0)) {
             // get error message from the stack
-            error = lua_tostring(L, -1);
+            if(error) {
+                const char* e = lua_tostring(L, -1);
+                *error = e ? e : "error";
+            }
             lua_pop(L, 1);
             return up.url;
         }
@@ -155,20 +579,49 @@ namespace bt {
         }
 
         // read return value
-        string r = lua_tostring(L, -1);
+        const char* r = lua_tostring(L, -1);
+        string url = r ? r : up.url;
         lua_pop(L, 1);
-        return r;
+        return url;
     }
 
     void script_site::handle_lua_print(const std::string& msg) {
-        print_buffer += msg + "\n";
+        // pooled states may print from several threads at once
+        lock_guard<mutex> lock{print_mutex};
+
+        // a ring of recent lines, so that scripts printing on every click don't grow memory forever
+        print_lines.push_back(msg.size() < MaxPrintBytes ? msg : msg.substr(0, MaxPrintBytes - 1));
+        print_bytes += print_lines.back().size() + 1;
+        while(print_bytes > MaxPrintBytes) {
+            print_bytes -= print_lines.front().size() + 1;
+            print_lines.pop_front();
+        }
+
         if(on_print) {
             on_print(msg);
         }
     }
 
-    void script_site::lua_push(const click_payload& up) {
-        // set global table "p" with 3 members: url, window_title, process_name
+    std::string script_site::get_print_buffer() const {
+        lock_guard<mutex> lock{print_mutex};
+        string r;
+        r.reserve(print_bytes);
+        for(const string& line : print_lines) {
+            r += line;
+            r += '\n';
+        }
+        return r;
+    }
+
+    void script_site::clear_print_buffer() {
+        lock_guard<mutex> lock{print_mutex};
+        print_lines.clear();
+        print_bytes = 0;
+    }
+
+    void script_site::lease::push(const click_payload& up) {
+        // set global table "p" with 3 members: url, window_title, process_name,
+        // plus scheme, host, path, query and params parsed from url on first access
         lua_newtable(L);
         lua_pushstring(L, up.url.c_str());
         lua_setfield(L, -2, "url");
@@ -176,28 +629,47 @@ namespace bt {
         lua_setfield(L, -2, "wt");
         lua_pushstring(L, up.process_name.c_str());
         lua_setfield(L, -2, "pn");
+        luaL_setmetatable(L, ClickMetatable);
         lua_setglobal(L, "p");
     }
 
-    void script_site::discover_function_names() {
-        all_function_names.clear();
-        bt_function_names.clear();
-        ppl_function_names.clear();
-        rule_function_names.clear();
+    std::vector<std::string> script_site::discover_function_names(lua_State* L) {
+        // every Lua function reachable from a global, however it was defined; library functions are C functions
+        vector<pair<int, string>> found;
+        lua_pushglobaltable(L);
+        lua_pushnil(L);
+        while(lua_next(L, -2)) {
+            if(lua_type(L, -2) == LUA_TSTRING && lua_isfunction(L, -1) && !lua_iscfunction(L, -1)) {
+                lua_Debug ar;
+                lua_pushvalue(L, -1);
+                lua_getinfo(L, ">S", &ar);
+                found.emplace_back(ar.linedefined, lua_tostring(L, -2));
+            }
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+
+        // in the order they appear in the script, as pipeline steps run in this order
+        sort(found.begin(), found.end());
+
+        vector<string> names;
+        for(auto& f : found) names.push_back(std::move(f.second));
+        return names;
+    }
+
+    void script_site::set_function_names(program& p, std::vector<std::string> names) {
+        p.all_function_names = std::move(names);
+        p.bt_function_names.clear();
+        p.ppl_function_names.clear();
+        p.rule_function_names.clear();
 
-        // use regex to list function names
-        regex re{ R"(function\s+(\w+))" };
-        sregex_iterator it{ code.begin(), code.end(), re };
-        sregex_iterator end;
-        for (; it != end; ++it) {
-            string n = it->str(1);
+        for(const string& n : p.all_function_names) {
             bool is_rule = n.starts_with(LuaRulePrefix);
             bool is_pipeline = n.starts_with(LuaPipelinePrefix);
 
-            all_function_names.push_back(n);
-            if (is_rule || is_pipeline) bt_function_names.push_back(n);
-            if (is_pipeline) ppl_function_names.push_back(n);
-            if (is_rule) rule_function_names.push_back(n);
+            if (is_rule || is_pipeline) p.bt_function_names.push_back(n);
+            if (is_pipeline) p.ppl_function_names.push_back(n);
+            if (is_rule) p.rule_function_names.push_back(n);
         }
     }
 }
\ No newline at end of file
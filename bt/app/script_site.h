@@ -3,29 +3,97 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <cstdint>
 #include "click_payload.h"
 
 namespace bt {
     class script_site {
     public:
+        /**
+         * @brief Lua state taken from the pool, for exclusive use until the lease is destroyed. Hold one per click, so
+         * that all Lua rules of a click see the same globals.
+         */
+        class lease {
+        public:
+            lease() = default;
+            lease(const lease&) = delete;
+            lease& operator=(const lease&) = delete;
+            lease(lease&& other) noexcept;
+            lease& operator=(lease&& other) noexcept;
+            ~lease();
+
+            explicit operator bool() const { return L != nullptr; }
+
+            /**
+             * @param error set to Lua error message if the call fails
+             */
+            bool call_rule(const click_payload& up, const std::string& function_name, std::string* error = nullptr);
+
+            std::string call_ppl(const click_payload& up, const std::string& function_name, std::string* error = nullptr);
+
+        private:
+            friend class script_site;
+
+            lease(const script_site* site, lua_State* L, std::uint64_t generation)
+                : site{site}, L{L}, generation{generation} {}
+
+            const script_site* site{nullptr};
+            lua_State* L{nullptr};
+            std::uint64_t generation{0};
+
+            void push(const click_payload& up);
+            void release();
+        };
+
+        /**
+         * @brief Lua garbage collector modes, see the Lua manual (2.5).
+         */
+        enum class gc_mode : unsigned int {
+            incremental = 0,
+            generational = 1
+        };
+
+        /**
+         * @brief Most recent print output kept by get_print_buffer(), in bytes. Older lines are dropped.
+         */
+        static constexpr size_t MaxPrintBytes = 64 * 1024;
+
         script_site(const std::string& path_or_code, bool is_path);
         ~script_site();
 
-        std::string print_buffer;
         std::function<void(const std::string&)> on_print;
 
-        std::vector<std::string> all_function_names;    // all function names
-        std::vector<std::string> bt_function_names;     // all function names which in some way are relevant to business logic
-        std::vector<std::string> ppl_function_names;    // all function names which are relevant to pipeline processing
-        std::vector<std::string> rule_function_names;   // all function names which are relevant to rule processing
+        // Function names, in the order they appear in the script. Copies, as a reload may replace them at any time.
+
+        std::vector<std::string> get_function_names() const;        // all function names
+        std::vector<std::string> get_bt_function_names() const;     // all function names which in some way are relevant to business logic
+        std::vector<std::string> get_ppl_function_names() const;    // all function names which are relevant to pipeline processing
+        std::vector<std::string> get_rule_function_names() const;   // all function names which are relevant to rule processing
 
+        /**
+         * @brief Loads the code again and swaps it in. Compiling and running the chunk happen before the swap, so
+         * evaluations on other threads carry on with the previous code meanwhile, and states they have leased keep it
+         * until returned. Thread safe.
+         */
         void reload();
 
+        /**
+         * @brief Same as reload(), but only if the script file now has different code, e.g. when it was edited
+         * outside of the app.
+         * @return whether it reloaded
+         */
+        bool reload_if_changed();
+
         std::string get_path() const { return is_path ? path_or_code : ""; }
-        std::string get_error() const { return error; }
+        std::string get_error() const;
 
         // code as string manipulation
-        std::string get_code() const { return code; }
+        std::string get_code() const;
         void set_code(const std::string& code);
 
         // bt specific functions
@@ -36,15 +104,164 @@ namespace bt {
 
         void handle_lua_print(const std::string& msg);
 
+        /**
+         * @brief Recent print output, a line per call, at most MaxPrintBytes.
+         */
+        std::string get_print_buffer() const;
+        void clear_print_buffer();
+
+        // --- state pool
+
+        /**
+         * @brief Takes a Lua state with the script loaded from the pool. A new state is created from the compiled chunk
+         * when all are in use, unless there are already get_pool_size() of them, in which case it waits for one to be
+         * returned. Thread safe.
+         *
+         * Every state runs the script's top-level code when it's created, so side effects there (such as print output)
+         * happen once per pooled state, not once per script.
+         * @return empty lease if the script failed to load
+         */
+        lease acquire() const;
+
+        /**
+         * @brief Maximum number of Lua states, i.e. how many evaluations can run in parallel. Defaults to the number of
+         * hardware threads.
+         */
+        size_t get_pool_size() const;
+        void set_pool_size(size_t size);
+
+        /**
+         * @brief Number of states created so far and not yet closed, for tests and diagnostics.
+         */
+        size_t get_state_count() const;
+
+        // --- memory
+
+        /**
+         * @brief Bytes currently allocated by all Lua states of this script, including idle ones.
+         */
+        size_t get_memory_usage() const { return heap_bytes.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief Highest get_memory_usage() seen since the script site was created.
+         */
+        size_t get_peak_memory_usage() const { return heap_peak.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief Sets garbage collector mode of all states. Leased states switch when they are returned.
+         * @param step_size incremental mode step size, as log2 of bytes (Lua's default is 13, i.e. 8 KB), 0 keeps the
+         * default. Ignored in generational mode.
+         */
+        void set_gc(gc_mode mode, int step_size = 0);
+        gc_mode get_gc_mode() const;
+        int get_gc_step_size() const;
+
+        // --- chunk cache
+
+        /**
+         * @brief File keeping the compiled chunk and function names of a script loaded from a file, next to it. When
+         * the code hasn't changed since, they are reused instead of compiling and walking globals again.
+         */
+        std::string get_cache_path() const;
+
+        /**
+         * @brief Whether the last reload used the chunk cache, for tests and diagnostics.
+         */
+        bool is_from_cache() const;
+
     private:
+        /**
+         * @brief What loading the code produced. Never changed once published, a reload publishes a new one instead.
+         */
+        struct program {
+            std::string code;
+
+            /**
+             * @brief Compiled chunk, loaded into every new state instead of parsing the source again.
+             */
+            std::string bytecode;
+
+            std::vector<std::string> all_function_names;
+            std::vector<std::string> bt_function_names;
+            std::vector<std::string> ppl_function_names;
+            std::vector<std::string> rule_function_names;
+            bool from_cache{false};
+        };
+
         bool is_path;
         std::string path_or_code;
-        std::string code;
+
+        /**
+         * @brief Current program, guarded by pool_mutex.
+         */
+        std::shared_ptr<const program> current;
+
+        mutable std::mutex error_mutex;
         std::string error;
-        lua_State* L{nullptr};
 
-        void lua_push(const click_payload& up);
+        mutable std::mutex pool_mutex;
+        mutable std::condition_variable pool_returned;
+        mutable std::vector<lua_State*> idle;
+        mutable size_t state_count{0};
+        size_t pool_size;
+
+        /**
+         * @brief Bumped on reload, states of older generations are closed when returned instead of being reused.
+         */
+        std::uint64_t generation{0};
+
+        mutable std::mutex print_mutex;
+        std::deque<std::string> print_lines;
+        size_t print_bytes{0};
+
+        mutable std::atomic<size_t> heap_bytes{0};
+        mutable std::atomic<size_t> heap_peak{0};
+        gc_mode gc{gc_mode::incremental};
+        int gc_step_size{0};
+
+        /**
+         * @brief lua_Alloc keeping track of heap_bytes, ud is the script site.
+         */
+        static void* lua_alloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+        /**
+         * @brief Applies gc settings to a state. Called with pool_mutex held.
+         */
+        void apply_gc(lua_State* L) const;
+
+        std::shared_ptr<const program> get_program() const;
+
+        std::string read_code() const;
+
+        /**
+         * @brief Builds a program from code and publishes it, see reload().
+         */
+        void load(std::string code);
+
+        void set_error(const std::string& e);
+
+        /**
+         * @brief Compiles code of the program into its bytecode.
+         * @return false on syntax error, which is put in error
+         */
+        bool compile(program& p, std::string& error) const;
+
+        bool load_cache(program& p) const;
+        void save_cache(const program& p) const;
+
+        /**
+         * @brief New state with the compiled chunk loaded and run. Garbage collector settings are not applied, the
+         * caller does that with pool_mutex held.
+         * @param error set if running the chunk fails
+         */
+        lua_State* new_state(const std::string& bytecode, std::string* error = nullptr) const;
+        void close_idle();
+
+        /**
+         * @brief Finds functions defined by the script in globals of a state which has run the chunk.
+         */
+        static std::vector<std::string> discover_function_names(lua_State* L);
 
-        void discover_function_names();
+        static void set_function_names(program& p, std::vector<std::string> names);
     };
-}
\ No newline at end of file
+}
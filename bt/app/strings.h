@@ -17,7 +17,12 @@ namespace bt::strings {
 
     const std::string LuaScript{"Lua script"};
     const std::string LuaScriptTooltip{"function name to execute"};
+    const std::string RuleIsASubstring{"Rule matches if the text appears anywhere"};
     const std::string RuleIsARegex{"Rule is a Regular Expression (advanced)"};
+    const std::string RuleIsAList{"Rule is a path to a file with a list of domains, one per line. Matches if URL host or any of its parent domains is listed"};
+    const std::string RuleIsAnExpression{"Rule is a compound expression, for example: domain:teams.microsoft.com and (process:outlook.exe or not title:\"Private\"). Tests are url:, domain:, path:, title: and process:"};
+    const std::string RuleIsExact{"Rule matches only if the whole text is equal to it, for example the exact process name (slack.exe). Fastest rule type"};
+    const std::string RuleIsAGlob{"Rule is a wildcard pattern: * matches anything, ? matches a single character, **. matches any number of subdomains"};
     const std::string RulePickProcessName{"List currently running processes"};
 
     const std::string PickerUrlTooltip{"Editable before opening"};
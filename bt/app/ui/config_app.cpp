@@ -82,13 +82,21 @@ namespace bt::ui {
 
         // in case config is not set, explicitly set it to default
         if(!g_config.browsers.empty()) {
-            g_config.default_profile_long_id =
-                browser::get_default(g_config.browsers, g_config.default_profile_long_id)->long_id();
+            string default_id = browser::get_default(g_config.browsers, g_config.default_profile_long_id)->long_id();
+            if(default_id != g_config.default_profile_long_id) {
+                g_config.default_profile_long_id = default_id;
+                g_config.reindex();
+            }
         }
 
         // re-create start menu shortcut in case it's missing
         win32::shell::create_start_menu_shortcut(APP_LONG_NAME);
 
+        // pick up browsers and profiles that were installed or changed since last time, this is cheap thanks to discovery cache
+        if(!g_config.browsers.empty()) {
+            rediscover_browsers(false);
+        }
+
         check_health();
     }
 
@@ -131,6 +139,8 @@ namespace bt::ui {
     bool config_app::run_frame() {
         w::guard gw{wnd_config};
 
+        complete_rediscovery();
+
         render_menu_bar();
 
         if(g_config.browsers.empty()) {
@@ -448,8 +458,11 @@ namespace bt::ui {
                 w::label(g_script.get_error(), w::emphasis::error);
             }
 
-            w::combo("##fn", g_script.bt_function_names, script_fn_selected, 250);
-            string func_name = g_script.bt_function_names.empty() ? "" : g_script.bt_function_names[script_fn_selected];
+            // script may be reloaded from disk in the background, with fewer functions
+            vector<string> bt_function_names = g_script.get_bt_function_names();
+            if(script_fn_selected >= bt_function_names.size()) script_fn_selected = 0;
+            w::combo("##fn", bt_function_names, script_fn_selected, 250);
+            string func_name = bt_function_names.empty() ? "" : bt_function_names[script_fn_selected];
             bool is_ppl = func_name.starts_with(LuaPipelinePrefix);
             w::tt("function to execute");
 
@@ -477,8 +490,9 @@ namespace bt::ui {
                     up.process_name = g_config.pv_last_pn;
 
                     if(is_ppl) {
+                        g_script.clear_print_buffer();
                         string out_url = g_script.call_ppl(up, func_name);
-                        script_terminal += g_script.print_buffer;
+                        script_terminal += g_script.get_print_buffer();
                         script_terminal += fmt::format("result: {}\n------------\n", out_url);
                     } else {
 
@@ -487,9 +501,9 @@ namespace bt::ui {
                             script_terminal += fmt::format("pipeline changed URL to '{}'\n", up.url);
                         }
 
-                        g_script.print_buffer.clear();
+                        g_script.clear_print_buffer();
                         bool matched = g_script.call_rule(up, func_name);
-                        script_terminal += g_script.print_buffer;
+                        script_terminal += g_script.get_print_buffer();
 
                         script_terminal += fmt::format("rule match: {}\n------------\n", matched);
                     }
@@ -519,6 +533,27 @@ namespace bt::ui {
             w::tt("auto-scroll");
             w::input_ml("##script_terminal", script_terminal, -FLT_MIN, script_terminal_autoscroll);
         }
+
+        w::sep("Memory");
+        {
+            w::label(fmt::format("{} {} KB in {} interpreter(s), peak {} KB", ICON_MD_MEMORY,
+                g_script.get_memory_usage() / 1024, g_script.get_state_count(), g_script.get_peak_memory_usage() / 1024));
+
+            unsigned int mode = g_config.script_gc_generational ? 1 : 0;
+            w::combo("garbage collector", {"incremental", "generational"}, mode, 150);
+            bool changed = (mode == 1) != g_config.script_gc_generational;
+            g_config.script_gc_generational = mode == 1;
+            if(!g_config.script_gc_generational) {
+                w::sl();
+                changed |= w::slider(g_config.script_gc_step_size, 0, 20, "step size (log2 bytes, 0 is default)");
+            }
+            if(changed) {
+                g_script.set_gc(g_config.script_gc_generational
+                    ? script_site::gc_mode::generational
+                    : script_site::gc_mode::incremental,
+                    g_config.script_gc_step_size);
+            }
+        }
     }
 
     void config_app::render_pipe_visualiser_window() {
@@ -734,9 +769,24 @@ namespace bt::ui {
         w::label(fmt::format("{} {}", ICON_MD_RULE, irc), 0, false);
         w::tt("Configured rule count");
 
+        if(g_script.get_state_count() > 0) {
+            w::sl();
+            w::label(fmt::format("{} {} KB", ICON_MD_MEMORY, g_script.get_memory_usage() / 1024), 0, false);
+            w::tt(fmt::format("Lua memory in use (peak {} KB)", g_script.get_peak_memory_usage() / 1024));
+        }
+
         w::sl();
         w::label("|", 0, false);
 
+        if(is_discovering()) {
+            w::sl();
+            w::label(fmt::format("{} discovering {}/{}", ICON_MD_REFRESH, discovery_done.load(), discovery_total.load()),
+                w::emphasis::primary);
+            w::tt("Browser discovery is in progress");
+            w::sl();
+            w::label("|", 0, false);
+        }
+
         w::sl();
         w::label(ICON_MD_COFFEE, 0, false);
         w::tt("Support this app, buy me a coffee!");
@@ -985,6 +1035,7 @@ namespace bt::ui {
             w::sl();
             if(w::button(ICON_MD_FAVORITE)) {
                 g_config.default_profile_long_id = b->instances[0]->long_id();
+                g_config.reindex();
             }
             w::tt("Make this browser the default one");
 
@@ -1000,6 +1051,7 @@ namespace bt::ui {
 
                 // erase and save
                 std::erase_if(g_config.browsers, [b](auto i) { return i->id == b->id; });
+                g_config.reindex();
 
                 // if possible, select previous browser
                 if(idx != string::npos) {
@@ -1051,6 +1103,7 @@ namespace bt::ui {
                         }
                         else if(w::button(ICON_MD_FAVORITE, w::emphasis::primary)) {
                             g_config.default_profile_long_id = bi->long_id();
+                            g_config.reindex();
                         }
                         w::tt("Make this browser the default one");
 
@@ -1211,6 +1264,9 @@ terminal window will be hidden.)");
         //w::label("Rules");
         w::sep("Rules");
 
+        // rule table needs rebuilding when anything changes below
+        vector<string> rules_before = bi->get_rules_as_text_clean();
+
         if(w::button(ICON_MD_ADD " add", w::emphasis::primary)) {
             bi->add_rule(fmt::format("rule {}", bi->rules.size()));
         }
@@ -1231,6 +1287,10 @@ terminal window will be hidden.)");
                 auto rule = bi->rules[i];
                 string si = std::to_string(i);
 
+                // to recompile the rule if it gets edited below
+                string value_before = rule->value;
+                match_type type_before = rule->type;
+
                 // location
                 w::combo(string{"##loc"} + si, 
                     rule_locations, (unsigned int&)rule->loc, 90);
@@ -1241,20 +1301,21 @@ terminal window will be hidden.)");
                 if(rule->loc == match_location::lua_script) {
 
                     // get selected index
+                    vector<string> rule_function_names = g_script.get_rule_function_names();
                     unsigned int selected{0};
-                    for(unsigned int j = 0; j < g_script.rule_function_names.size(); j++) {
-                        if(g_script.rule_function_names[j] == rule->value) {
+                    for(unsigned int j = 0; j < rule_function_names.size(); j++) {
+                        if(rule_function_names[j] == rule->value) {
                             selected = j;
                             break;
                         }
                     }
 
-                    w::combo(val_label, g_script.rule_function_names, selected, 250);
+                    w::combo(val_label, rule_function_names, selected, 250);
                     w::tt(strings::LuaScriptTooltip);
 
                     // reassign value
-                    if(!g_script.rule_function_names.empty()) {
-                        rule->value = g_script.rule_function_names[selected];
+                    if(!rule_function_names.empty()) {
+                        rule->value = rule_function_names[selected];
                     }
 
                 } else {
@@ -1270,11 +1331,12 @@ terminal window will be hidden.)");
                     }
                 }
 
-                // is regex checkbox (not for Lua)
+                // rule type (not for Lua)
                 if(rule->loc != match_location::lua_script) {
                     w::sl();
-                    w::icon_checkbox(ICON_MD_GRAIN, rule->is_regex);
-                    w::tt(strings::RuleIsARegex);
+                    size_t type = static_cast<size_t>(rule->type);
+                    w::icon_list(rule_types, type);
+                    rule->type = static_cast<match_type>(type);
                 }
 
                 // app mode
@@ -1321,6 +1383,10 @@ terminal window will be hidden.)");
                     }
                 }
 
+                if(rule->value != value_before || rule->type != type_before) {
+                    rule->compile();
+                }
+
                 w::sl();
                 if(w::button(string{ICON_MD_DELETE} + "##" + to_string(i), w::emphasis::error)) {
                     bi->delete_rule(rule->value);
@@ -1328,6 +1394,10 @@ terminal window will be hidden.)");
                 w::tt("Delete rule");
             }
         }
+
+        if(bi->get_rules_as_text_clean() != rules_before) {
+            g_config.reindex();
+        }
     }
 
     void config_app::refresh_pop_proc_names_items() {
@@ -1351,13 +1421,32 @@ terminal window will be hidden.)");
         pop_proc_names_filter.clear();
     }
 
-    void config_app::rediscover_browsers() {
-        vector<shared_ptr<browser>> fresh_browsers = discovery::discover_all_browsers();
+    void config_app::rediscover_browsers(bool notify) {
+        if(is_discovering()) return;
+
+        discovery_notify = notify;
+        discovery_done = 0;
+        discovery_total = 0;
+        discovery_task = std::async(std::launch::async, [this]() {
+            return discovery::discover_all_browsers([this](size_t done, size_t total, const string&) {
+                discovery_total = total;
+                discovery_done = done;
+            });
+        });
+    }
+
+    void config_app::complete_rediscovery() {
+        if(!is_discovering() || discovery_task.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+
+        vector<shared_ptr<browser>> fresh_browsers = discovery_task.get();
         fresh_browsers = browser::merge(fresh_browsers, g_config.browsers);
         g_config.browsers = fresh_browsers;
+        g_config.reindex();
 
-        string message = fmt::format("Discovered {} browser(s).", g_config.browsers.size());
-        w::notify_info(message);
+        if(discovery_notify) {
+            string message = fmt::format("Discovered {} browser(s).", g_config.browsers.size());
+            w::notify_info(message);
+        }
     }
 
     void config_app::add_custom_browser_by_asking() {
@@ -1371,6 +1460,7 @@ terminal window will be hidden.)");
         b->instances.push_back(make_shared<browser_instance>(b, "default", name, "", ""));
 
         g_config.browsers.push_back(b);
+        g_config.reindex();
 
         // find this new browser and select it (it won't be the last in the list)
         size_t idx = browser::index_of(g_config.browsers, b);
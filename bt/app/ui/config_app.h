@@ -4,6 +4,8 @@
 #include <memory>
 #include <map>
 #include <vector>
+#include <future>
+#include <atomic>
 #include "../browser.h"
 #include "../setup.h"
 #include "../strings.h"
@@ -88,6 +90,14 @@ namespace bt::ui {
         bool pv_only_matching{false};
 
         std::vector<std::string> rule_locations { "URL", "Title", "Process", strings::LuaScript };
+        std::vector<std::pair<std::string, std::string>> rule_types{
+            { ICON_MD_TEXT_FIELDS, strings::RuleIsASubstring },
+            { ICON_MD_GRAIN, strings::RuleIsARegex },
+            { ICON_MD_EMERGENCY, strings::RuleIsAGlob },
+            { ICON_MD_LIST, strings::RuleIsAList },
+            { ICON_MD_ACCOUNT_TREE, strings::RuleIsAnExpression },
+            { ICON_MD_DRAG_HANDLE, strings::RuleIsExact }
+        };
         std::vector<std::pair<std::string, std::string>> url_scopes{
             { ICON_MD_LANGUAGE, "Match anywhere" },
             { ICON_MD_GITE, "Match only in host name" },
@@ -120,7 +130,20 @@ namespace bt::ui {
         void render_rules(std::shared_ptr<browser_instance> bi);
         void refresh_pop_proc_names_items();
 
-        void rediscover_browsers();
+        // browser discovery runs in the background, progress is reported from the worker thread. The task is declared
+        // last so that it's destroyed (and waited for) before the counters it reports to.
+        std::atomic<size_t> discovery_done{0};
+        std::atomic<size_t> discovery_total{0};
+        bool discovery_notify{true};
+        std::future<std::vector<std::shared_ptr<bt::browser>>> discovery_task;
+        bool is_discovering() const { return discovery_task.valid(); }
+
+        /**
+         * @brief Starts browser discovery in the background. Results are merged into configuration when ready.
+         * @param notify whether to show a notification when finished
+         */
+        void rediscover_browsers(bool notify = true);
+        void complete_rediscovery();
         void add_custom_browser_by_asking();
 
         void recalculate_test_url_matches(const click_payload& cp);
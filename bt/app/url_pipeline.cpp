@@ -14,9 +14,9 @@ namespace bt {
 
     void url_pipeline::clean(std::string& s) {
         // remove custom protocol prefix
-        size_t sz = string(CustomProtoName).size();
+        size_t sz = string_view(CustomProtoName).size();
         if(s.starts_with(CustomProtoName) && s.size() > sz + 3) {
-            s = s.substr(sz + 3);
+            s.erase(0, sz + 3);
         }
 
         // Firefox for some reason removes ':' when opening custom protocol links, so we need to add it back
@@ -24,7 +24,7 @@ namespace bt {
         if(idx == string::npos) {
             idx = s.find("//");
             if(idx != string::npos) {
-                s = s.substr(0, idx) + ":" + s.substr(idx);
+                s.insert(idx, 1, ':');
             }
         }
     }
@@ -70,7 +70,7 @@ namespace bt {
         }
 
         if(cfg.pipeline_script) {
-            for(string fn : g_script.ppl_function_names) {
+            for(string fn : g_script.get_ppl_function_names()) {
                 steps.push_back(make_shared<bt::pipeline::script>(fn));
             }
         }
@@ -11,4 +11,10 @@ namespace bt {
             default: return "unknown";
         }
     }
+
+    std::string_view url_pipeline_step::host_of(std::string_view url) {
+        size_t idx = url.find("://");
+        if(idx != std::string_view::npos) url = url.substr(idx + 3);
+        return url.substr(0, url.find('/'));
+    }
 }
\ No newline at end of file
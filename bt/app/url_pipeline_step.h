@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include "click_payload.h"
 
 namespace bt {
@@ -30,5 +31,11 @@ namespace bt {
     protected:
         url_pipeline_step(url_pipeline_step_type type)
             : type{type} {}
+
+        /**
+         * @brief Host part of the URL, split the same way as the url class does, but without allocating. Lets steps
+         * skip URLs they don't care about before parsing them.
+         */
+        static std::string_view host_of(std::string_view url);
     };
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "win32/os.h"
 #include "app/rule_hit_log.h"
 #include "app/url_opener.h"
+#include "app/click_arena.h"
 #include "cmdline.h"
 #include "app/discovery.h"
 
@@ -27,8 +28,17 @@ void open(bt::click_payload up, bool force_picker = false) {
 
     //::MessageBox(nullptr, L"open-up", L"Command Line Debugger", MB_OK);
 
+    // hit log keeps the URL as clicked, see rule_hit_log::write
+    const string clicked_url = up.url;
     g_pipeline.process(up);
 
+    // temporaries of this click, released when it's routed
+    bt::click_arena arena;
+
+    // decisions of earlier clicks, so that frequently opened URLs don't go through all the rules every time
+    bt::decision_cache cache;
+    bt::config::open_decision_cache(cache);
+
     // decision whether to show picker or not
     bool show_picker{force_picker};
     string pick_reason;
@@ -40,11 +50,11 @@ void open(bt::click_payload up, bool force_picker = false) {
             show_picker = true;
             pick_reason = "hotkey";
         } else if(g_config.picker_on_conflict || g_config.picker_on_no_rule) {
-            auto matches = bt::browser::match(g_config.browsers, up, g_config.default_profile_long_id, g_script);
+            auto matches = g_config.match(up, g_script, cache, arena.get());
             if(g_config.picker_on_conflict && matches.size() > 1) {
                 show_picker = true;
                 pick_reason = "conflict";
-            } else if(g_config.picker_on_no_rule && matches[0].rule.is_fallback) {
+            } else if(g_config.picker_on_no_rule && matches[0].rule->is_fallback) {
                 show_picker = true;
                 pick_reason = "no rule";
             }
@@ -52,22 +62,25 @@ void open(bt::click_payload up, bool force_picker = false) {
     }
 
     if(show_picker) {
+        // picker may stay open for a while, pick up deployed changes meanwhile
+        g_config.start_watching(g_script);
         bt::ui::picker_app app{up.url};
         auto bi = app.run();
+        g_config.stop_watching();
         if(bi) {
             up.url = bi.url;
             bt::url_opener::open(bi.decision, up);
             if(g_config.log_rule_hits) {
-                bt::rule_hit_log::i.write(up, bi.decision, "picker:" + pick_reason);
+                bt::rule_hit_log::i.write(up, bi.decision, "picker:" + pick_reason, clicked_url);
             }
         }
     } else {
-        auto matches = bt::browser::match(g_config.browsers, up, g_config.default_profile_long_id, g_script);
+        auto matches = g_config.match(up, g_script, cache, arena.get());
         bt::browser_match_result& first_match = matches[0];
-        first_match.rule.apply_to(up);
+        first_match.rule->apply_to(up);
         bt::url_opener::open(first_match.bi, up);
         if(g_config.log_rule_hits) {
-            bt::rule_hit_log::i.write(up, first_match.bi, matches[0].rule.to_line());
+            bt::rule_hit_log::i.write(up, first_match.bi, matches[0].rule->to_line(), clicked_url);
         }
 
         if(g_config.toast_on_open) {
@@ -78,16 +91,16 @@ void open(bt::click_payload up, bool force_picker = false) {
 }
 
 string get_command(const string& data, string& command_data) {
-    // Find the position of the first space character
-    size_t pos = data.find(' ');
+    // Find the position of the first space character, or the argument splitter when command has no arguments
+    size_t pos = data.find_first_of(" " ArgSplitter);
 
-    // If no space is found, return the entire string
+    // If neither is found, there is no command
     if(pos == std::string::npos) {
         return "";
     }
 
-    // Return the substring from the beginning up to the space character
-    command_data = data.substr(pos + 1);
+    // Return the substring from the beginning up to the space character. Splitter is kept in command data.
+    command_data = data[pos] == ' ' ? data.substr(pos + 1) : data.substr(pos);
     return data.substr(0, pos);
 }
 
@@ -101,8 +114,13 @@ void execute(const string& data) {
     if(data.empty() || data.starts_with(ArgSplitter)) {
         // if data starts with argsplitter that means command line is empty
 
-        bt::ui::config_app app;
-        app.run();
+        // stays open, so pick up changes made to configuration and script files meanwhile
+        g_config.start_watching(g_script);
+        {
+            bt::ui::config_app app;
+            app.run();
+        }
+        g_config.stop_watching();
 
         return;
     }
@@ -116,7 +134,7 @@ void execute(const string& data) {
             // force-invoke the picker
             force_picker = true;
             clean_data = command_data;
-        } else if(command == "browser") {
+        } else if(command == "browser" || command == "route" || command == "replay") {
             cmdline c;
             c.exec(command, command_data);
             return;
@@ -124,6 +142,7 @@ void execute(const string& data) {
             vector<shared_ptr<bt::browser>> fresh_browsers = bt::discovery::discover_all_browsers();
             fresh_browsers = bt::browser::merge(fresh_browsers, g_config.browsers);
             g_config.browsers = fresh_browsers;
+            g_config.reindex();
             g_config.commit();
             return;
         }
@@ -218,6 +237,11 @@ int wmain(int argc, wchar_t* argv[], wchar_t* envp[]) {
 
     string arg = parse_args(argc, argv);
 
+    g_script.set_gc(g_config.script_gc_generational
+        ? bt::script_site::gc_mode::generational
+        : bt::script_site::gc_mode::incremental,
+        g_config.script_gc_step_size);
+
     execute(arg);
 
     return 0;
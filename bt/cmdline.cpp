@@ -1,24 +1,49 @@
 #include "cmdline.h"
 #include <Windows.h>
 #include <iostream>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <nlohmann/json.hpp>
 #include "globals.h"
 #include "str.h"
+#include "app/router.h"
+#include "app/rule_hit_log.h"
+#include "app/matching/regex_prefilter.h"
 
 using namespace std;
+using json = nlohmann::json;
+
+/**
+ * @brief Whether the standard handle points to a file or a pipe, i.e. was redirected by the caller.
+ */
+static bool is_redirected(DWORD std_handle) {
+    HANDLE h = ::GetStdHandle(std_handle);
+    if(h == nullptr || h == INVALID_HANDLE_VALUE) return false;
+    DWORD type = ::GetFileType(h);
+    return type == FILE_TYPE_DISK || type == FILE_TYPE_PIPE;
+}
 
 cmdline::cmdline(){
+    bool in_redirected = is_redirected(STD_INPUT_HANDLE);
+    bool out_redirected = is_redirected(STD_OUTPUT_HANDLE);
+    bool err_redirected = is_redirected(STD_ERROR_HANDLE);
+
     // Attach to the parent process's console or create a new one
     if(!::AttachConsole(ATTACH_PARENT_PROCESS)) {
         AllocConsole();
     }
 
-    // Redirect standard input, output, and error streams to the console
-    freopen("CONIN$", "r", stdin);
-    freopen("CONOUT$", "w", stdout);
-    freopen("CONOUT$", "w", stderr);
+    // Redirect standard input, output, and error streams to the console, unless they are already redirected (i.e. piped)
+    if(!in_redirected) freopen("CONIN$", "r", stdin);
+    if(!out_redirected) freopen("CONOUT$", "w", stdout);
+    if(!err_redirected) freopen("CONOUT$", "w", stderr);
 }
 
 int cmdline::exec(const std::string& command, const std::string& data) {
+    if(command == "route") return exec_route(data);
+    if(command == "replay") return exec_replay(data);
+
     // browser related queries
     if(data.starts_with("list|")) return exec_list();
     if(data.starts_with("get default|")) return exec_get_default();
@@ -111,23 +136,224 @@ int cmdline::exec_set_default(const std::string& data) {
 
     wcout << L"setting default browser to " << str::to_wstr(browser_id) << L"." << str::to_wstr(profile_id) << endl;
 
-    // find browser
-    for(const auto& b : g_config.browsers) {
-        if(b->id == browser_id) {
-            wcout << L"found browser: " << str::to_wstr(b->name) << endl;
-            // find profile
-            for(const auto& p : b->instances) {
-                if(p->id == profile_id) {
-                    wcout << L"found profile: " << str::to_wstr(p->name) << endl;
-                    g_config.default_profile_long_id = p->long_id();
-                    g_config.commit();
-                    wcout << L"default profile set and saved." << endl;
-                    return 0;
-                }
-            }
-        }
+    // find profile
+    auto p = g_config.find_profile(browser_id + ":" + profile_id);
+    if(p) {
+        wcout << L"found browser: " << str::to_wstr(p->b->name) << endl;
+        wcout << L"found profile: " << str::to_wstr(p->name) << endl;
+        g_config.default_profile_long_id = p->long_id();
+        g_config.commit();
+        wcout << L"default profile set and saved." << endl;
+        return 0;
     }
 
     wcout << L"browser or profile not found" << endl;
     return 1;
 }
+
+int cmdline::exec_route(const std::string& data) {
+    // data is in the following form: "[path]|suffix", path is optional and stdin is used when it's empty
+    string path = data.substr(0, data.rfind('|'));
+    str::trim(path);
+
+    if(g_config.browsers.empty()) {
+        cerr << json{{"error", "no browsers configured"}}.dump() << endl;
+        return 1;
+    }
+
+    ifstream file;
+    if(!path.empty()) {
+        file.open(path);
+        if(!file.is_open()) {
+            cerr << json{{"error", "can't open input file"}, {"path", path}}.dump() << endl;
+            return 1;
+        }
+    }
+    istream& in = path.empty() ? cin : file;
+
+    size_t count{0};
+    size_t skipped{0};
+    size_t line_no{0};
+    chrono::nanoseconds pipeline_total{0};
+    chrono::nanoseconds match_total{0};
+    size_t allocations_total{0};
+    size_t heap_allocations_total{0};
+    bt::matching::regex_prefilter::reset_stats();
+    auto started = chrono::steady_clock::now();
+
+    string line;
+    while(getline(in, line)) {
+        line_no += 1;
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        if(line.empty() || line.starts_with("#")) continue;
+
+        // url, window title, process name, by position, so that any of the latter two can be empty
+        string fields[3];
+        size_t begin{0};
+        for(size_t f = 0; f < 3 && begin <= line.size(); f++) {
+            size_t end = f < 2 ? line.find('\t', begin) : string::npos;
+            fields[f] = line.substr(begin, end == string::npos ? string::npos : end - begin);
+            begin = end == string::npos ? line.size() + 1 : end + 1;
+        }
+
+        str::trim(fields[0]);
+        if(fields[0].empty()) {
+            skipped += 1;
+            cerr << json{{"error", "no url"}, {"line", line_no}}.dump() << endl;
+            continue;
+        }
+
+        bt::click_payload up{fields[0]};
+        up.window_title = fields[1];
+        up.process_name = fields[2];
+
+        bt::route_result rr = bt::router::route(up);
+        const bt::browser_match_result& decision = rr.matches[0];
+
+        auto pipeline_us = chrono::duration_cast<chrono::microseconds>(rr.pipeline_time).count();
+        auto match_us = chrono::duration_cast<chrono::microseconds>(rr.match_time).count();
+
+        json j{
+            {"url", up.url},
+            {"final_url", rr.up.url},
+            {"window_title", up.window_title},
+            {"process_name", up.process_name},
+            {"profile", decision.bi->long_id()},
+            {"profile_name", decision.bi->get_best_display_name()},
+            {"rule", decision.rule->to_line()},
+            {"fallback", decision.rule->is_fallback},
+            {"matches", rr.matches.size()},
+            {"pipeline_us", pipeline_us},
+            {"match_us", match_us},
+            {"allocations", rr.allocations.allocations},
+            {"allocated_bytes", rr.allocations.bytes},
+            {"heap_allocations", rr.allocations.heap_allocations}
+        };
+        cout << j.dump() << '\n';
+
+        count += 1;
+        pipeline_total += rr.pipeline_time;
+        match_total += rr.match_time;
+        allocations_total += rr.allocations.allocations;
+        heap_allocations_total += rr.allocations.heap_allocations;
+    }
+    cout.flush();
+
+    // summary goes to stderr so that stdout stays one decision per line
+    auto elapsed = chrono::steady_clock::now() - started;
+    double elapsed_sec = chrono::duration<double>(elapsed).count();
+    bt::matching::regex_prefilter::stats rx = bt::matching::regex_prefilter::get_stats();
+    cerr << json{
+        {"urls", count},
+        {"skipped", skipped},
+        {"elapsed_ms", chrono::duration<double, milli>(elapsed).count()},
+        {"pipeline_ms", chrono::duration<double, milli>(pipeline_total).count()},
+        {"match_ms", chrono::duration<double, milli>(match_total).count()},
+        {"urls_per_sec", elapsed_sec > 0 ? count / elapsed_sec : 0},
+        {"allocations_per_url", count > 0 ? static_cast<double>(allocations_total) / count : 0},
+        {"heap_allocations_per_url", count > 0 ? static_cast<double>(heap_allocations_total) / count : 0},
+        {"regex", {
+            {"evaluated", rx.evaluated},
+            {"skipped_by_prefilter", rx.skipped},
+            {"executed", rx.executed},
+            {"matched", rx.matched}}}
+    }.dump() << endl;
+
+    return 0;
+}
+
+int cmdline::exec_replay(const std::string& data) {
+    // data is in the following form: "[path]|suffix", default hit log is used when path is empty
+    const size_t SlowestCount = 10;
+
+    string path = data.substr(0, data.rfind('|'));
+    str::trim(path);
+    if(path.empty()) {
+        path = bt::rule_hit_log::i.get_absolute_path();
+    }
+
+    if(g_config.browsers.empty()) {
+        cerr << json{{"error", "no browsers configured"}}.dump() << endl;
+        return 1;
+    }
+
+    size_t skipped{0};
+    vector<bt::rule_hit_log_entry> entries = bt::rule_hit_log::read(path, skipped);
+
+    size_t replayed{0};
+    size_t manual{0};
+    size_t mismatches{0};
+    chrono::nanoseconds route_total{0};
+    vector<pair<chrono::nanoseconds, string>> slowest;
+    auto started = chrono::steady_clock::now();
+
+    for(const bt::rule_hit_log_entry& e : entries) {
+        // logged url is as clicked, so the pipeline runs on it exactly once, as it did then. Logs written before 5.7.0
+        // have the processed URL there instead.
+        bt::click_payload up{e.url};
+        up.window_title = e.window_title;
+        up.process_name = e.process_name;
+
+        bt::route_result rr = bt::router::route(up);
+        const bt::browser_match_result& decision = rr.matches[0];
+        chrono::nanoseconds took = rr.pipeline_time + rr.match_time;
+
+        replayed += 1;
+        route_total += took;
+
+        // keep top N slowest
+        slowest.emplace_back(took, e.url);
+        std::sort(slowest.begin(), slowest.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        if(slowest.size() > SlowestCount) slowest.pop_back();
+
+        // decisions made by a human in the picker can't be reproduced
+        if(e.rule.starts_with("picker:")) {
+            manual += 1;
+            continue;
+        }
+
+        string rule = decision.rule->to_line();
+        if(decision.bi->b->id == e.browser_id && decision.bi->name == e.profile_name && rule == e.rule) continue;
+
+        mismatches += 1;
+        cout << json{
+            {"timestamp", e.timestamp},
+            {"url", e.url},
+            {"window_title", e.window_title},
+            {"process_name", e.process_name},
+            {"logged", {
+                {"browser_id", e.browser_id},
+                {"profile_name", e.profile_name},
+                {"rule", e.rule},
+                {"final_url", e.open_url}}},
+            {"replayed", {
+                {"browser_id", decision.bi->b->id},
+                {"profile_name", decision.bi->name},
+                {"rule", rule},
+                {"final_url", rr.up.url}}}
+        }.dump() << '\n';
+    }
+    cout.flush();
+
+    auto elapsed = chrono::steady_clock::now() - started;
+    double elapsed_sec = chrono::duration<double>(elapsed).count();
+    json j_slowest = json::array();
+    for(const auto& s : slowest) {
+        j_slowest.push_back({
+            {"url", s.second},
+            {"us", chrono::duration_cast<chrono::microseconds>(s.first).count()}});
+    }
+    cerr << json{
+        {"path", path},
+        {"replayed", replayed},
+        {"skipped", skipped},
+        {"manual", manual},
+        {"mismatches", mismatches},
+        {"elapsed_ms", chrono::duration<double, milli>(elapsed).count()},
+        {"route_ms", chrono::duration<double, milli>(route_total).count()},
+        {"urls_per_sec", elapsed_sec > 0 ? replayed / elapsed_sec : 0},
+        {"slowest", j_slowest}
+    }.dump() << endl;
+
+    return mismatches > 0 ? 2 : 0;
+}
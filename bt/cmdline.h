@@ -11,4 +11,16 @@ private:
     int exec_list();
     int exec_get_default();
     int exec_set_default(const std::string& data);
+
+    /**
+     * @brief Routes URLs read from a file or stdin, one per line, and prints decisions as JSON lines.
+     * Each line is "url[<TAB>window title[<TAB>process name]]".
+     */
+    int exec_route(const std::string& data);
+
+    /**
+     * @brief Replays hit log (hit_log.csv by default) through the current configuration and reports decisions
+     * that differ from the logged ones as JSON lines. Returns 2 if any decision differs.
+     */
+    int exec_replay(const std::string& data);
 };
\ No newline at end of file
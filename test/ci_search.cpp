@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <fmt/core.h>
+#include "str.h"
+#include "../bt/app/matching/ci_search.h"
+
+using namespace std;
+using namespace bt::matching;
+
+static string folded(string s) {
+    ci_search::fold_ascii(s);
+    return s;
+}
+
+static void expect_all(const string& haystack, const string& needle, bool expected) {
+    string fn = folded(needle);
+    EXPECT_EQ(expected, ci_search::contains_scalar(haystack, fn)) << "scalar: '" << needle << "' in '" << haystack << "'";
+    EXPECT_EQ(expected, ci_search::contains_sse2(haystack, fn)) << "sse2: '" << needle << "' in '" << haystack << "'";
+    if(ci_search::has_avx2()) {
+        EXPECT_EQ(expected, ci_search::contains_avx2(haystack, fn)) << "avx2: '" << needle << "' in '" << haystack << "'";
+    }
+    EXPECT_EQ(expected, ci_search::contains(haystack, fn));
+}
+
+TEST(CiSearch, Basic) {
+    expect_all("https://GitHub.com/aloneguid/bt", "github", true);
+    expect_all("https://github.com/aloneguid/bt", "GITHUB.COM", true);
+    expect_all("https://github.com/aloneguid/bt", "gitlab", false);
+    expect_all("short", "much longer needle", false);
+    expect_all("anything", "", true);
+    expect_all("", "", true);
+    expect_all("", "a", false);
+}
+
+TEST(CiSearch, Boundaries) {
+    // needle at every position of haystacks around SIMD block sizes
+    for(size_t len : {1, 2, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100}) {
+        for(size_t nlen : {1, 2, 3, 8, 16, 17, 33}) {
+            if(nlen > len) continue;
+            for(size_t pos = 0; pos + nlen <= len; pos++) {
+                string h(len, 'x');
+                string n(nlen, 'y');
+                n[0] = 'A';
+                n[nlen - 1] = 'Z';
+                h.replace(pos, nlen, n);
+                expect_all(h, folded(n), true);
+                expect_all(h, n + "q", false);
+            }
+        }
+    }
+}
+
+TEST(CiSearch, NonLettersAreNotFolded) {
+    // '@' and '[' are next to 'A' and 'Z', and must not be folded into '`' or '{'
+    expect_all("@[", "`", false);
+    expect_all("@[", "{", false);
+    expect_all("\xC3\x9C" "ber", "\xC3\xBC" "ber", false);
+    expect_all("\xC3\x9C" "BER", "\xC3\x9C" "ber", true);
+}
+
+TEST(CiSearch, MatchesContainsIc) {
+    mt19937 rng{42};
+    const string alphabet = "abcABC./-_:xyzXYZ09";
+    uniform_int_distribution<size_t> ch(0, alphabet.size() - 1);
+    uniform_int_distribution<size_t> hl(0, 80);
+    uniform_int_distribution<size_t> nl(1, 4);
+
+    for(int i = 0; i < 20000; i++) {
+        string h, n;
+        for(size_t j = hl(rng); j > 0; j--) h += alphabet[ch(rng)];
+        for(size_t j = nl(rng); j > 0; j--) n += alphabet[ch(rng)];
+
+        expect_all(h, n, str::contains_ic(h, n));
+    }
+}
+
+// benchmark, run manually with --gtest_also_run_disabled_tests --gtest_filter=*Bench*
+TEST(CiSearch, DISABLED_Bench) {
+    vector<string> haystacks;
+    for(int i = 0; i < 1000; i++) {
+        haystacks.push_back(fmt::format(
+            "https://Www.Example-{}.com/Some/Fairly/Long/Path/To/A/Resource?query=Value&utm_source=Newsletter&id={}", i, i * 7));
+    }
+    vector<string> needles{"github.com", "utm_campaign", "/resource?", "microsoft.sharepoint.com", "example-999."};
+    vector<string> folded_needles;
+    for(auto& n : needles) folded_needles.push_back(folded(n));
+
+    auto bench = [&](const string& name, auto fn) {
+        size_t hits{0};
+        auto t0 = chrono::steady_clock::now();
+        for(int round = 0; round < 100; round++) {
+            for(const string& h : haystacks) {
+                for(size_t k = 0; k < needles.size(); k++) {
+                    hits += fn(h, k) ? 1 : 0;
+                }
+            }
+        }
+        auto us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - t0).count();
+        cout << name << ": " << us << " us, " << hits << " hits" << endl;
+        return hits;
+    };
+
+    size_t expected = bench("str::contains_ic", [&](const string& h, size_t k) { return str::contains_ic(h, needles[k]); });
+    EXPECT_EQ(expected, bench("scalar", [&](const string& h, size_t k) { return ci_search::contains_scalar(h, folded_needles[k]); }));
+    EXPECT_EQ(expected, bench("sse2", [&](const string& h, size_t k) { return ci_search::contains_sse2(h, folded_needles[k]); }));
+    if(ci_search::has_avx2()) {
+        EXPECT_EQ(expected, bench("avx2", [&](const string& h, size_t k) { return ci_search::contains_avx2(h, folded_needles[k]); }));
+    }
+    cout << "selected: " << ci_search::get_impl_name() << endl;
+}
@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "../bt/app/click_arena.h"
+
+using namespace std;
+
+TEST(ClickArena, SmallClickStaysInline) {
+    bt::click_arena arena;
+
+    pmr::vector<int> v{arena.get()};
+    for(int i = 0; i < 100; i++) v.push_back(i);
+    pmr::string s{"a string long enough to not fit into small string buffer", arena.get()};
+
+    EXPECT_GT(arena.get_stats().allocations, 0);
+    EXPECT_GT(arena.get_stats().bytes, 0);
+    EXPECT_EQ(0, arena.get_stats().heap_allocations);
+}
+
+TEST(ClickArena, GrowsFromHeap) {
+    bt::click_arena arena;
+
+    pmr::vector<char> v{arena.get()};
+    v.resize(bt::click_arena::InlineSize * 2);
+
+    EXPECT_GT(arena.get_stats().heap_allocations, 0);
+}
+
+TEST(ClickArena, Release) {
+    bt::click_arena arena;
+    {
+        pmr::vector<char> v{arena.get()};
+        v.resize(bt::click_arena::InlineSize * 2);
+    }
+
+    arena.release();
+    EXPECT_EQ(0, arena.get_stats().allocations);
+    EXPECT_EQ(0, arena.get_stats().heap_allocations);
+
+    pmr::vector<char> v{arena.get()};
+    v.resize(100);
+    EXPECT_EQ(1, arena.get_stats().allocations);
+    EXPECT_EQ(0, arena.get_stats().heap_allocations);
+}
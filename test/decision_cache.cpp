@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include "../bt/app/decision_cache.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+using namespace bt;
+
+class DecisionCache : public ::testing::Test {
+protected:
+    fs::path path;
+
+    void SetUp() override {
+        path = fs::temp_directory_path() / "bt_decision_cache_test.cache";
+        fs::remove(path);
+    }
+
+    void TearDown() override {
+        error_code ec;
+        fs::remove(path, ec);
+    }
+
+    static decision_cache::decision make(uint32_t rule, uint32_t instance) {
+        decision_cache::decision d;
+        d.long_id = decision_cache::hash("b:" + to_string(instance));
+        d.count = 1;
+        d.hits[0] = {rule, instance};
+        return d;
+    }
+};
+
+TEST_F(DecisionCache, PutGet) {
+    decision_cache cache;
+    ASSERT_TRUE(cache.open(path.string()));
+
+    decision_cache::decision d;
+    EXPECT_FALSE(cache.get(1, 10, d));
+
+    cache.put(1, 10, make(5, 2));
+    ASSERT_TRUE(cache.get(1, 10, d));
+    EXPECT_EQ(1, d.count);
+    EXPECT_EQ(5, d.hits[0].rule);
+    EXPECT_EQ(2, d.hits[0].instance);
+    EXPECT_EQ(decision_cache::hash("b:2"), d.long_id);
+
+    // different rules
+    EXPECT_FALSE(cache.get(1, 11, d));
+
+    // overwritten in place
+    cache.put(1, 11, make(6, 3));
+    EXPECT_FALSE(cache.get(1, 10, d));
+    ASSERT_TRUE(cache.get(1, 11, d));
+    EXPECT_EQ(6, d.hits[0].rule);
+
+    // no rule matched
+    cache.put(0, 10, decision_cache::decision{});
+    ASSERT_TRUE(cache.get(0, 10, d));
+    EXPECT_EQ(0, d.count);
+
+    cache.clear();
+    EXPECT_FALSE(cache.get(1, 11, d));
+}
+
+TEST_F(DecisionCache, SharedBetweenInstances) {
+    {
+        decision_cache cache;
+        ASSERT_TRUE(cache.open(path.string()));
+        cache.put(42, 1, make(1, 1));
+    }
+
+    decision_cache a, b;
+    ASSERT_TRUE(a.open(path.string()));
+    ASSERT_TRUE(b.open(path.string()));
+
+    decision_cache::decision d;
+    EXPECT_TRUE(a.get(42, 1, d));
+
+    // written through one mapping, seen through the other
+    b.put(43, 1, make(2, 2));
+    ASSERT_TRUE(a.get(43, 1, d));
+    EXPECT_EQ(2, d.hits[0].rule);
+}
+
+TEST_F(DecisionCache, ClockKeepsReferencedEntries) {
+    decision_cache cache;
+    ASSERT_TRUE(cache.open(path.string()));
+
+    // all keys land in the same set
+    const uint64_t step = decision_cache::SetCount;
+    for(uint64_t i = 1; i <= decision_cache::Ways; i++) {
+        cache.put(i * step, 1, make(static_cast<uint32_t>(i), 0));
+    }
+
+    // everything but the first entry is used again
+    decision_cache::decision d;
+    for(uint64_t i = 2; i <= decision_cache::Ways; i++) {
+        ASSERT_TRUE(cache.get(i * step, 1, d));
+    }
+
+    uint64_t extra = (decision_cache::Ways + 1) * step;
+    cache.put(extra, 1, make(100, 0));
+    EXPECT_TRUE(cache.get(extra, 1, d));
+    EXPECT_FALSE(cache.get(step, 1, d));
+    for(uint64_t i = 2; i <= decision_cache::Ways; i++) {
+        EXPECT_TRUE(cache.get(i * step, 1, d)) << i;
+    }
+}
+
+TEST_F(DecisionCache, InvalidFileStartsOver) {
+    {
+        ofstream out{path, ios::binary};
+        out << "definitely not a cache";
+    }
+
+    decision_cache cache;
+    ASSERT_TRUE(cache.open(path.string()));
+    decision_cache::decision d;
+    EXPECT_FALSE(cache.get(0, 0, d));
+    cache.put(7, 7, make(7, 7));
+    EXPECT_TRUE(cache.get(7, 7, d));
+}
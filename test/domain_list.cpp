@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include "../bt/app/matching/domain_list.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+using namespace bt::matching;
+
+class DomainList : public ::testing::Test {
+protected:
+    fs::path dir;
+    fs::path source;
+
+    void SetUp() override {
+        dir = fs::temp_directory_path() / "bt_domain_list_test";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        source = dir / "list.txt";
+        domain_list::configure(dir.string(), (dir / "cache").string());
+    }
+
+    void TearDown() override {
+        domain_list::configure("", "");
+        error_code ec;
+        fs::remove_all(dir, ec);
+    }
+
+    void write(const string& content) {
+        ofstream out{source, ios::trunc};
+        out << content;
+    }
+};
+
+TEST_F(DomainList, Lookup) {
+    write("# comment\n"
+        "example.com\n"
+        "*.Contoso.net\n"
+        "0.0.0.0 ads.tracker.org  # hosts file style\n"
+        "\n");
+
+    auto dl = domain_list::get("list.txt");
+    ASSERT_TRUE(dl);
+    EXPECT_EQ(3, dl->size());
+
+    EXPECT_TRUE(dl->contains_host("example.com"));
+    EXPECT_TRUE(dl->contains_host("www.EXAMPLE.com"));
+    EXPECT_TRUE(dl->contains_host("a.b.example.com:8080"));
+    EXPECT_TRUE(dl->contains_host("user@contoso.net"));
+    EXPECT_TRUE(dl->contains_host("ads.tracker.org."));
+    EXPECT_FALSE(dl->contains_host("tracker.org"));
+    EXPECT_FALSE(dl->contains_host("notexample.com"));
+    EXPECT_FALSE(dl->contains_host("com"));
+    EXPECT_FALSE(dl->contains_host(""));
+}
+
+TEST_F(DomainList, Large) {
+    {
+        ofstream out{source};
+        for(int i = 0; i < 50000; i++) out << "domain" << i << ".test\n";
+    }
+
+    auto dl = domain_list::get(source.string());
+    ASSERT_TRUE(dl);
+    EXPECT_EQ(50000, dl->size());
+    EXPECT_TRUE(dl->contains_host("www.domain0.test"));
+    EXPECT_TRUE(dl->contains_host("domain49999.test"));
+    EXPECT_FALSE(dl->contains_host("domain50000.test"));
+}
+
+TEST_F(DomainList, RecompiledOnlyWhenSourceChanges) {
+    write("one.com\n");
+    auto a = domain_list::get("list.txt");
+    auto b = domain_list::get("list.txt");
+    ASSERT_TRUE(a);
+    EXPECT_EQ(a, b);
+    EXPECT_EQ(1, distance(fs::directory_iterator(dir / "cache"), fs::directory_iterator{}));
+
+    // make sure modification time changes
+    this_thread::sleep_for(chrono::milliseconds(20));
+    write("one.com\ntwo.com\n");
+    auto c = domain_list::get("list.txt");
+    ASSERT_TRUE(c);
+    EXPECT_NE(a, c);
+    EXPECT_TRUE(c->contains_host("two.com"));
+    EXPECT_FALSE(a->contains_host("two.com"));
+}
+
+TEST_F(DomainList, MissingSource) {
+    EXPECT_FALSE(domain_list::get("missing.txt"));
+}
+
+TEST_F(DomainList, InvalidTable) {
+    write("not a table");
+    EXPECT_FALSE(domain_list::open(source.string()));
+}
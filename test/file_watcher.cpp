@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../bt/app/file_watcher.h"
+
+using namespace std;
+using namespace std::chrono;
+namespace fs = std::filesystem;
+
+namespace {
+    /**
+     * @brief Collects paths reported by a watcher.
+     */
+    struct changes {
+        mutex m;
+        condition_variable cv;
+        vector<string> paths;
+
+        void add(const string& path) {
+            {
+                lock_guard<mutex> lock{m};
+                paths.push_back(path);
+            }
+            cv.notify_all();
+        }
+
+        /**
+         * @brief Waits until path has been reported at least count times.
+         */
+        bool wait_for(const string& path, size_t count, milliseconds timeout = milliseconds{5000}) {
+            unique_lock<mutex> lock{m};
+            return cv.wait_for(lock, timeout, [&]() {
+                return static_cast<size_t>(std::count(paths.begin(), paths.end(), path)) >= count;
+            });
+        }
+
+        size_t count(const string& path) {
+            lock_guard<mutex> lock{m};
+            return std::count(paths.begin(), paths.end(), path);
+        }
+    };
+
+    void write(const fs::path& path, const string& content) {
+        ofstream out{path, ios::trunc};
+        out << content;
+    }
+
+    /**
+     * @brief Second watched file, changed to prove that the watcher has polled. It's watched after the file under
+     * test, so once its change is reported, any change to that file made before would have been reported too.
+     */
+    struct sentinel {
+        fs::path path = fs::temp_directory_path() / "bt_file_watcher_sentinel.ini";
+        string content;
+
+        sentinel() { write(path, content); }
+        ~sentinel() { fs::remove(path); }
+
+        bool poll(changes& c) {
+            size_t seen = c.count(path.string());
+            content += "x";
+            write(path, content);
+            return c.wait_for(path.string(), seen + 1);
+        }
+    };
+}
+
+TEST(FileWatcher, ReportsChange) {
+    fs::path path = fs::temp_directory_path() / "bt_file_watcher_test.ini";
+    write(path, "a=1\n");
+
+    changes c;
+    sentinel s;
+    {
+        bt::file_watcher w{{path.string(), s.path.string()}, [&c](const string& p) { c.add(p); }, milliseconds{20}};
+
+        // nothing happened yet
+        ASSERT_TRUE(s.poll(c));
+        EXPECT_EQ(0, c.count(path.string()));
+
+        write(path, "a=1\nb=2\n");
+        ASSERT_TRUE(c.wait_for(path.string(), 1));
+
+        // reported once
+        ASSERT_TRUE(s.poll(c));
+        EXPECT_EQ(1, c.count(path.string()));
+    }
+
+    fs::remove(path);
+}
+
+TEST(FileWatcher, MissingFileIsReportedWhenCreated) {
+    fs::path path = fs::temp_directory_path() / "bt_file_watcher_missing.ini";
+    fs::remove(path);
+
+    changes c;
+    sentinel s;
+    {
+        bt::file_watcher w{{path.string(), s.path.string()}, [&c](const string& p) { c.add(p); }, milliseconds{20}};
+        ASSERT_TRUE(s.poll(c));
+        EXPECT_EQ(0, c.count(path.string()));
+
+        write(path, "a=1\n");
+        EXPECT_TRUE(c.wait_for(path.string(), 1));
+
+        // deleting is not a change
+        fs::remove(path);
+        ASSERT_TRUE(s.poll(c));
+        EXPECT_EQ(1, c.count(path.string()));
+    }
+}
+
+TEST(FileWatcher, StopsQuickly) {
+    auto t0 = steady_clock::now();
+    {
+        bt::file_watcher w{{"does-not-exist"}, [](const string&) {}, milliseconds{10000}};
+    }
+    EXPECT_LT(steady_clock::now() - t0, milliseconds{2000});
+}
@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include "../bt/app/matching/glob.h"
+
+using namespace std;
+using namespace bt::matching;
+
+TEST(Glob, Literal) {
+    EXPECT_TRUE(glob{"github.com"}.match("GitHub.com"));
+    EXPECT_FALSE(glob{"github.com"}.match("github.com/"));
+    EXPECT_FALSE(glob{"github.com"}.match("www.github.com"));
+    EXPECT_TRUE(glob{""}.match(""));
+    EXPECT_FALSE(glob{""}.match("x"));
+}
+
+TEST(Glob, Star) {
+    glob g{"*.atlassian.net/wiki/*"};
+    EXPECT_TRUE(g.match("https://contoso.atlassian.net/wiki/"));
+    EXPECT_TRUE(g.match("https://contoso.atlassian.net/wiki/spaces/X"));
+    EXPECT_FALSE(g.match("https://contoso.atlassian.net/jira/"));
+    EXPECT_FALSE(g.match("atlassian.net/wiki/"));
+
+    EXPECT_TRUE(glob{"*"}.match(""));
+    EXPECT_TRUE(glob{"a**b"}.match("ab"));
+    EXPECT_TRUE(glob{"*a*a*a*"}.match("banana a"));
+    EXPECT_FALSE(glob{"*a*a*a*a*"}.match("banana"));
+}
+
+TEST(Glob, QuestionMark) {
+    EXPECT_TRUE(glob{"a?c"}.match("abc"));
+    EXPECT_FALSE(glob{"a?c"}.match("ac"));
+    EXPECT_FALSE(glob{"a?c"}.match("abbc"));
+}
+
+TEST(Glob, Labels) {
+    glob g{"**.example.com"};
+    EXPECT_TRUE(g.match("example.com"));
+    EXPECT_TRUE(g.match("www.example.com"));
+    EXPECT_TRUE(g.match("a.b.c.Example.com"));
+    EXPECT_FALSE(g.match("notexample.com"));
+    EXPECT_FALSE(g.match(".example.com"));
+
+    glob u{"https://**.example.com/*"};
+    EXPECT_TRUE(u.match("https://example.com/"));
+    EXPECT_TRUE(u.match("https://docs.example.com/page"));
+    EXPECT_FALSE(u.match("https://evil.com/x.example.com/"));
+}
+
+TEST(Glob, NoBacktracking) {
+    glob g{"*a*a*a*a*a*a*a*a*a*a*b"};
+    EXPECT_FALSE(g.match(string(100000, 'a')));
+}
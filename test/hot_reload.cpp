@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <string>
+#include "../bt/app/hot_reload.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+    void write(const fs::path& path, const string& content) {
+        ofstream out{path, ios::trunc};
+        out << content;
+    }
+
+    /**
+     * @brief Reads the whole file as the value, counting reads.
+     */
+    struct file_reader {
+        shared_ptr<int> reads = make_shared<int>(0);
+
+        shared_ptr<const string> operator()(const string& path) const {
+            (*reads)++;
+            ifstream in{path};
+            stringstream ss;
+            ss << in.rdbuf();
+            return make_shared<const string>(ss.str());
+        }
+    };
+}
+
+TEST(HotReload, OutsideChangeSurvivesPublishAndCommit) {
+    fs::path path = fs::temp_directory_path() / "bt_hot_reload_commit.ini";
+    write(path, "a\n");
+
+    bt::hot_reload<string> h{file_reader{}};
+    h.publish(make_shared<const string>("a\n"));
+
+    // edited outside and picked up by the watcher
+    write(path, "a\nb\n");
+    h.reload(path.string());
+    EXPECT_EQ("a\nb\n", *h.get());
+
+    // the app publishes from its model, which doesn't have "b"
+    h.publish(make_shared<const string>("a\nc\n"));
+    EXPECT_EQ("a\nc\n", *h.get());
+
+    // commit writes the model's changes into the file, which keeps "b"
+    write(path, "a\nb\nc\n");
+    h.committed(path.string(), true);
+    EXPECT_EQ("a\nb\nc\n", *h.get());
+
+    fs::remove(path);
+}
+
+TEST(HotReload, OutsideChangeSurvivesCommitWithNothingToWrite) {
+    fs::path path = fs::temp_directory_path() / "bt_hot_reload_nothing.ini";
+    write(path, "a\n");
+
+    bt::hot_reload<string> h{file_reader{}};
+    h.publish(make_shared<const string>("a\n"));
+
+    write(path, "a\nb\n");
+    h.reload(path.string());
+    h.publish(make_shared<const string>("a\n"));
+
+    h.committed(path.string(), false);
+    EXPECT_EQ("a\nb\n", *h.get());
+
+    fs::remove(path);
+}
+
+TEST(HotReload, OwnWriteIsNotLoaded) {
+    fs::path path = fs::temp_directory_path() / "bt_hot_reload_own.ini";
+    file_reader reader;
+
+    bt::hot_reload<string> h{reader};
+    h.publish(make_shared<const string>("a\n"));
+    write(path, "a\n");
+    h.committed(path.string(), true);
+
+    // watcher reports the app's own write
+    h.reload(path.string());
+    EXPECT_EQ(0, *reader.reads);
+
+    // nothing changed outside, so nothing to load on the next commit either
+    h.committed(path.string(), false);
+    EXPECT_EQ(0, *reader.reads);
+    EXPECT_EQ("a\n", *h.get());
+
+    fs::remove(path);
+}
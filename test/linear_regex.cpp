@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <regex>
+#include <random>
+#include "../bt/app/matching/linear_regex.h"
+
+using namespace std;
+using namespace bt::matching;
+
+static bool std_match(const string& pattern, const string& input) {
+    return regex_match(input, regex{pattern, regex_constants::icase});
+}
+
+static void expect_same(const string& pattern, const vector<string>& inputs) {
+    auto re = linear_regex::compile(pattern);
+    ASSERT_TRUE(re) << pattern;
+    for(const string& s : inputs) {
+        EXPECT_EQ(std_match(pattern, s), re->match(s)) << "'" << pattern << "' on '" << s << "'";
+    }
+}
+
+TEST(LinearRegex, Basic) {
+    vector<string> urls{
+        "", "https://github.com", "https://GitHub.com/aloneguid/bt", "http://github.com/", "https://contoso.sharepoint.com/sites/x",
+        "https://www.youtube.com/watch?v=123", "abc", "aaab", "a\nb", "ftp://x"
+    };
+
+    expect_same(".*\\.sharepoint\\.com.*", urls);
+    expect_same("^https?://(www\\.)?github\\.com(/.*)?$", urls);
+    expect_same("https://[a-z.]+/watch\\?v=\\d+", urls);
+    expect_same("(?:ftp|http)s?://\\w+.*", urls);
+    expect_same("a{2,3}b|abc", urls);
+    expect_same("a.b", urls);
+    expect_same("[^/]+//[^/]+", urls);
+    expect_same("\\x61bc", urls);
+    expect_same("a*?b", urls);
+    expect_same("", urls);
+    expect_same("(|a)bc", urls);
+}
+
+TEST(LinearRegex, Unsupported) {
+    EXPECT_FALSE(linear_regex::is_supported("(a)\\1"));
+    EXPECT_FALSE(linear_regex::is_supported("a(?=b)"));
+    EXPECT_FALSE(linear_regex::is_supported("\\bword\\b"));
+    EXPECT_FALSE(linear_regex::is_supported("a^b"));
+    EXPECT_FALSE(linear_regex::is_supported("a$b"));
+    EXPECT_FALSE(linear_regex::is_supported("[[:alpha:]]"));
+    EXPECT_FALSE(linear_regex::is_supported("a{2000}"));
+    EXPECT_FALSE(linear_regex::is_supported("(a"));
+    EXPECT_FALSE(linear_regex::is_supported("a)"));
+    EXPECT_FALSE(linear_regex::is_supported("a**"));
+    EXPECT_FALSE(linear_regex::is_supported("[z-a]"));
+    EXPECT_TRUE(linear_regex::is_supported("^a|b$"));
+}
+
+TEST(LinearRegex, NoCatastrophicBacktracking) {
+    auto re = linear_regex::compile("(a*)*b");
+    ASSERT_TRUE(re);
+    EXPECT_FALSE(re->match(string(100000, 'a')));
+    EXPECT_TRUE(re->match(string(100000, 'a') + "b"));
+}
+
+TEST(LinearRegex, SetMode) {
+    vector<string> patterns{".*github.*", ".*\\.com", "https://.*", "x+"};
+    auto set = linear_regex::compile(patterns);
+    ASSERT_TRUE(set);
+    EXPECT_EQ(4, set->pattern_count());
+
+    pmr::vector<bool> matched;
+    for(string s : {"https://github.com", "http://github.org", "xxx", "", "https://a.com"}) {
+        set->match_all(s, matched);
+        ASSERT_EQ(4, matched.size());
+        for(size_t i = 0; i < patterns.size(); i++) {
+            EXPECT_EQ(std_match(patterns[i], s), matched[i]) << patterns[i] << " on " << s;
+        }
+    }
+}
+
+TEST(LinearRegex, CacheFlush) {
+    // DFA for this needs far more states than the cache holds
+    auto re = linear_regex::compile("[ab]*a[ab]{12}");
+    ASSERT_TRUE(re);
+
+    mt19937 rng{3};
+    for(int i = 0; i < 200; i++) {
+        string s;
+        for(int j = 0; j < 40; j++) s += (rng() & 1) ? 'a' : 'b';
+        EXPECT_EQ(std_match("[ab]*a[ab]{12}", s), re->match(s)) << s;
+    }
+}
+
+TEST(LinearRegex, MatchesStdRegex) {
+    mt19937 rng{11};
+    const vector<string> atoms{"a", "b", "C", ".", "[a-c]", "[^b]", "\\d", "\\w", "\\.", "(a|bc)", "(?:b)", "x"};
+    const vector<string> quantifiers{"", "", "", "*", "+", "?", "{2}", "{1,2}", "{0,}", "*?"};
+    const string alphabet = "abcABx1.";
+
+    for(int i = 0; i < 300; i++) {
+        string pattern;
+        for(size_t n = 1 + rng() % 4; n > 0; n--) {
+            pattern += atoms[rng() % atoms.size()] + quantifiers[rng() % quantifiers.size()];
+        }
+        if(rng() % 4 == 0) pattern += "|" + atoms[rng() % atoms.size()];
+
+        vector<string> inputs;
+        for(int j = 0; j < 50; j++) {
+            string s;
+            for(size_t n = rng() % 6; n > 0; n--) s += alphabet[rng() % alphabet.size()];
+            inputs.push_back(s);
+        }
+        expect_same(pattern, inputs);
+    }
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include "../bt/app/matching/predicate_dag.h"
+
+using namespace std;
+using namespace bt;
+using namespace bt::matching;
+
+static bool eval(const string& expression, const click_payload& up) {
+    predicate_dag dag;
+    uint32_t root = dag.add(expression);
+    EXPECT_NE(predicate_dag::NoNode, root) << expression;
+    if(root == predicate_dag::NoNode) return false;
+
+    auto ctx = match_context::of(up, nullptr);
+    predicate_results results{dag, ctx.mem};
+    return results.test(root, ctx);
+}
+
+TEST(PredicateDag, Evaluate) {
+    click_payload up{"https://teams.microsoft.com/l/chat?x=1"};
+    up.window_title = "Inbox - Private Chat";
+    up.process_name = "OUTLOOK.EXE";
+
+    EXPECT_TRUE(eval("domain:teams.microsoft.com", up));
+    EXPECT_TRUE(eval("DOMAIN:Teams.Microsoft.com AND process:outlook.exe", up));
+    EXPECT_FALSE(eval("domain:teams.microsoft.com and process:chrome.exe", up));
+    EXPECT_TRUE(eval("process:chrome.exe or path:chat", up));
+    EXPECT_FALSE(eval("not url:teams", up));
+    EXPECT_TRUE(eval("not not url:teams", up));
+    EXPECT_TRUE(eval("title:\"private chat\"", up));
+    EXPECT_FALSE(eval("domain:chat", up));
+
+    // "and" binds tighter than "or"
+    EXPECT_TRUE(eval("url:nope and url:nope or url:teams", up));
+    EXPECT_FALSE(eval("url:nope and (url:nope or url:teams)", up));
+    EXPECT_TRUE(eval("not(url:nope)", up));
+
+    // empty parts never match
+    click_payload bare{"https://github.com"};
+    EXPECT_FALSE(eval("title:a or process:b or path:c", bare));
+    EXPECT_TRUE(eval("not title:a", bare));
+}
+
+TEST(PredicateDag, Invalid) {
+    string error;
+    EXPECT_FALSE(predicate_dag::is_valid("", &error));
+    EXPECT_FALSE(error.empty());
+    EXPECT_FALSE(predicate_dag::is_valid("url:a and"));
+    EXPECT_FALSE(predicate_dag::is_valid("url:a or or url:b"));
+    EXPECT_FALSE(predicate_dag::is_valid("(url:a"));
+    EXPECT_FALSE(predicate_dag::is_valid("url:a)"));
+    EXPECT_FALSE(predicate_dag::is_valid("host:a", &error));
+    EXPECT_NE(string::npos, error.find("host"));
+    EXPECT_FALSE(predicate_dag::is_valid("url:"));
+    EXPECT_FALSE(predicate_dag::is_valid("title:\"unterminated"));
+    EXPECT_FALSE(predicate_dag::is_valid(string(100, '(') + "url:a" + string(100, ')')));
+    EXPECT_TRUE(predicate_dag::is_valid("((url:a))"));
+}
+
+TEST(PredicateDag, SharesNodes) {
+    predicate_dag dag;
+    uint32_t a = dag.add("domain:teams.microsoft.com and process:outlook.exe");
+    size_t size = dag.size();
+
+    // same expression in a different order and case
+    EXPECT_EQ(a, dag.add("Process:OUTLOOK.EXE and domain:teams.microsoft.com"));
+    EXPECT_EQ(size, dag.size());
+
+    // only the new test and the new "or" are added
+    uint32_t b = dag.add("(domain:teams.microsoft.com and process:outlook.exe) or title:meeting");
+    EXPECT_NE(a, b);
+    EXPECT_EQ(size + 2, dag.size());
+
+    EXPECT_EQ(
+        (1u << static_cast<uint32_t>(input_part::host)) |
+        (1u << static_cast<uint32_t>(input_part::process)) |
+        (1u << static_cast<uint32_t>(input_part::title)),
+        dag.get_input_parts());
+}
+
+TEST(PredicateDag, EvaluatesSharedNodesOnce) {
+    predicate_dag dag;
+    uint32_t a = dag.add("domain:teams.microsoft.com and process:outlook.exe");
+    uint32_t b = dag.add("(process:outlook.exe and domain:teams.microsoft.com) or title:meeting");
+    uint32_t c = dag.add("not (domain:teams.microsoft.com and process:outlook.exe)");
+
+    click_payload up{"https://teams.microsoft.com"};
+    up.process_name = "outlook.exe";
+    auto ctx = match_context::of(up, nullptr);
+    predicate_results results{dag, ctx.mem};
+
+    EXPECT_TRUE(results.test(a, ctx));
+    EXPECT_EQ(3, results.get_evaluated_count());
+
+    // "or" short-circuits on the shared "and", title is never looked at
+    EXPECT_TRUE(results.test(b, ctx));
+    EXPECT_FALSE(results.test(c, ctx));
+    EXPECT_EQ(5, results.get_evaluated_count());
+}
@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+#include <regex>
+#include <random>
+#include "../bt/app/matching/regex_prefilter.h"
+
+using namespace std;
+using namespace bt::matching;
+
+TEST(RegexPrefilter, Extract) {
+    EXPECT_EQ(vector<string>{".sharepoint.com"}, regex_prefilter::extract(".*\\.sharepoint\\.com.*"));
+    EXPECT_EQ((vector<string>{"github.com/", "https://"}), regex_prefilter::extract("^https://(www\\.)?GitHub\\.com/.*"));
+    EXPECT_EQ((vector<string>{"https://", "/page"}), regex_prefilter::extract("https://[a-z]+/page"));
+    EXPECT_EQ((vector<string>{"abc", "de"}), regex_prefilter::extract("abc+dex?"));
+    EXPECT_EQ(vector<string>{"xa"}, regex_prefilter::extract("xab{0,3}"));
+    EXPECT_EQ(vector<string>{"abb"}, regex_prefilter::extract("abb{2}"));
+}
+
+TEST(RegexPrefilter, NothingRequired) {
+    EXPECT_TRUE(regex_prefilter::extract("github|gitlab").empty());
+    EXPECT_TRUE(regex_prefilter::extract(".*").empty());
+    EXPECT_TRUE(regex_prefilter::extract("(github)").empty());
+    EXPECT_TRUE(regex_prefilter::extract("\\d+\\w*").empty());
+    EXPECT_TRUE(regex_prefilter::extract("\\x41\\u0042c").empty());
+    EXPECT_TRUE(regex_prefilter::extract("\xC3\xBC" "ber").empty());
+}
+
+TEST(RegexPrefilter, NeverRejectsMatches) {
+    mt19937 rng{7};
+    vector<string> patterns{
+        ".*\\.sharepoint\\.com.*", "https?://(www\\.)?github\\.com/.*", "ab+c*d?e", "a{2,}bc{0}d", "x[a-c]+yz",
+        "(foo|bar)baz.*", "q.*rs(t)?u", "\\w+@\\w+\\.com", "a\\.b\\-c", "abc??d"
+    };
+    const string alphabet = "abcdexyzqrstu.:/-@ABCXYZ";
+    uniform_int_distribution<size_t> ch(0, alphabet.size() - 1);
+    uniform_int_distribution<size_t> len(0, 12);
+
+    for(const string& p : patterns) {
+        regex rx{p, regex_constants::icase};
+        vector<string> lits = regex_prefilter::extract(p);
+        for(int i = 0; i < 20000; i++) {
+            string s;
+            for(size_t j = len(rng); j > 0; j--) s += alphabet[ch(rng)];
+            if(regex_match(s, rx)) {
+                EXPECT_TRUE(regex_prefilter::may_match(s, lits)) << p << " / " << s;
+            }
+        }
+    }
+}
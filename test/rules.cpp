@@ -55,6 +55,102 @@ TEST(Rules, MatchEmptyRule) {
     EXPECT_FALSE(bmr.is_match("x"));
 }
 
+TEST(Rules, MatchIgnoresCase) {
+
+    match_rule bmr{"GitHub"};
+
+    EXPECT_TRUE(bmr.is_match("https://GITHUB.com/aloneguid"));
+    EXPECT_TRUE(bmr.is_match("https://github.com/aloneguid"));
+}
+
+TEST(Rules, MatchAfterRecompile) {
+
+    match_rule bmr{"bla"};
+    bmr.value = "foo";
+    bmr.compile();
+
+    EXPECT_TRUE(bmr.is_match("http://foo.com"));
+    EXPECT_FALSE(bmr.is_match("http://bla.com"));
+
+    bmr.value = ".*\\.com.*";
+    bmr.type = match_type::regex;
+    bmr.compile();
+    EXPECT_TRUE(bmr.is_match("http://foo.com/page"));
+    EXPECT_FALSE(bmr.is_match("http://foo.org/page"));
+}
+
+TEST(Rules, MatchGlob) {
+
+    match_rule bmr{"type:glob|*.atlassian.net/wiki/*"};
+
+    EXPECT_TRUE(bmr.is_match("https://contoso.Atlassian.net/wiki/spaces/X"));
+    EXPECT_FALSE(bmr.is_match("https://contoso.atlassian.net/jira/browse/X-1"));
+
+    bmr.value = "**.atlassian.net";
+    bmr.scope = match_scope::domain;
+    bmr.compile();
+    EXPECT_TRUE(bmr.is_match("https://atlassian.net/"));
+    EXPECT_TRUE(bmr.is_match("https://a.b.atlassian.net/x"));
+    EXPECT_FALSE(bmr.is_match("https://notatlassian.net/x"));
+}
+
+TEST(Rules, MatchExact) {
+
+    match_rule bmr{"loc:process_name|type:exact|Slack.exe"};
+
+    click_payload up{"https://github.com"};
+    up.process_name = "SLACK.EXE";
+    EXPECT_TRUE(bmr.is_match(up));
+    up.process_name = "slack.exe.old";
+    EXPECT_FALSE(bmr.is_match(up));
+    up.process_name = "notslack.exe";
+    EXPECT_FALSE(bmr.is_match(up));
+
+    match_rule domain{"scope:domain|type:exact|github.com"};
+    EXPECT_TRUE(domain.is_match("https://GitHub.com/aloneguid"));
+    EXPECT_FALSE(domain.is_match("https://gist.github.com/"));
+    EXPECT_EQ("scope:domain|type:exact|github.com", domain.to_line());
+}
+
+TEST(Rules, MatchExpression) {
+
+    match_rule bmr{"type:expr|domain:teams.microsoft.com and process:outlook.exe"};
+    ASSERT_TRUE(bmr.get_expression());
+
+    click_payload up{"https://teams.microsoft.com/l/meetup-join/1"};
+    up.process_name = "OUTLOOK.EXE";
+    EXPECT_TRUE(bmr.is_match(up));
+    up.process_name = "chrome.exe";
+    EXPECT_FALSE(bmr.is_match(up));
+
+    // invalid expressions never match
+    bmr.value = "domain:teams.microsoft.com and";
+    bmr.compile();
+    EXPECT_FALSE(bmr.get_expression());
+    EXPECT_FALSE(bmr.is_match(up));
+}
+
+TEST(Rules, IdentityIncludesTypeAndLocation) {
+    // the same text looked at differently is a different rule, and add_rules keeps both
+    match_rule substring{"slack.exe"};
+    match_rule exact{"loc:process_name|type:exact|slack.exe"};
+    match_rule process{"loc:process_name|slack.exe"};
+    match_rule list{"list:foo"};
+    match_rule foo{"foo"};
+
+    EXPECT_FALSE(substring == exact);
+    EXPECT_FALSE(exact == process);
+    EXPECT_FALSE(list == foo);
+    EXPECT_NE(substring.get_identity(), exact.get_identity());
+    EXPECT_NE(exact.get_identity(), process.get_identity());
+    EXPECT_NE(list.get_identity(), foo.get_identity());
+
+    // priority and mode don't make a rule different
+    match_rule prioritised{"priority:3|mode:app|loc:process_name|type:exact|slack.exe"};
+    EXPECT_TRUE(exact == prioritised);
+    EXPECT_EQ(exact.get_identity(), prioritised.get_identity());
+}
+
 // --- serialisation ----
 
 TEST(Rules, Serialise) {
@@ -76,6 +172,12 @@ TEST(Rules, Serialise) {
     match_rule mr5{"p"};
     mr5.app_mode = true;
     EXPECT_EQ("mode:app|p", mr5.to_line());
+    match_rule mr6{"*.atlassian.net/wiki/*"};
+    mr6.type = match_type::glob;
+    EXPECT_EQ("type:glob|*.atlassian.net/wiki/*", mr6.to_line());
+    match_rule mr7{"url:a or not title:b"};
+    mr7.type = match_type::expr;
+    EXPECT_EQ("type:expr|url:a or not title:b", mr7.to_line());
 }
 
 TEST(Rules, Deserialise) {
@@ -106,6 +208,13 @@ TEST(Rules, Deserialise) {
     match_rule mr6{"just a co:lon"};
     EXPECT_EQ("just a co:lon", mr6.value);
     EXPECT_EQ(match_scope::any, mr6.scope);
+    match_rule mr7{"type:glob|*.atlassian.net/wiki/*"};
+    EXPECT_EQ("*.atlassian.net/wiki/*", mr7.value);
+    EXPECT_EQ(match_type::glob, mr7.type);
+    match_rule mr8{"priority:2|type:expr|url:a or not title:b"};
+    EXPECT_EQ("url:a or not title:b", mr8.value);
+    EXPECT_EQ(match_type::expr, mr8.type);
+    EXPECT_EQ(2, mr8.priority);
 }
 
 // --- parse URL ---
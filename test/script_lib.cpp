@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <fmt/core.h>
+#include "../bt/app/script_lib.h"
+#include "../bt/app/script_site.h"
+
+using namespace std;
+using namespace bt;
+
+TEST(ScriptLib, SplitUrl) {
+    auto u = script_lib::split_url("https://user@mail.example.com:8080/inbox/1?a=1&b=2#top");
+    EXPECT_EQ("https", u.scheme);
+    EXPECT_EQ("user@mail.example.com:8080", u.host);
+    EXPECT_EQ("/inbox/1", u.path);
+    EXPECT_EQ("a=1&b=2", u.query);
+
+    u = script_lib::split_url("example.com");
+    EXPECT_EQ("", u.scheme);
+    EXPECT_EQ("example.com", u.host);
+    EXPECT_EQ("", u.path);
+    EXPECT_EQ("", u.query);
+}
+
+TEST(ScriptLib, Host) {
+    EXPECT_TRUE(script_lib::host_is("https://GitHub.com/aloneguid", "github.com"));
+    EXPECT_TRUE(script_lib::host_is("https://user@github.com:443/", "github.com"));
+    EXPECT_TRUE(script_lib::host_is("github.com", "github.com"));
+    EXPECT_FALSE(script_lib::host_is("https://gist.github.com/", "github.com"));
+
+    EXPECT_TRUE(script_lib::host_ends("https://gist.github.com/", "github.com"));
+    EXPECT_TRUE(script_lib::host_ends("https://github.com./", "GitHub.com"));
+    EXPECT_FALSE(script_lib::host_ends("https://notgithub.com/", "github.com"));
+    EXPECT_FALSE(script_lib::host_ends("https://com/", "github.com"));
+}
+
+TEST(ScriptLib, Decode) {
+    EXPECT_EQ("a b/c", script_lib::url_decode("a%20b%2Fc"));
+    EXPECT_EQ("a+b", script_lib::url_decode("a+b"));
+    EXPECT_EQ("a b", script_lib::url_decode("a+b", true));
+    EXPECT_EQ("100%", script_lib::url_decode("100%"));
+    EXPECT_EQ("%zz", script_lib::url_decode("%zz"));
+    EXPECT_EQ("a%20b%2Fc~", script_lib::url_encode("a b/c~"));
+}
+
+TEST(ScriptLib, QueryString) {
+    const string url = "https://x.com/p?a=1&b=hello+world&a=2#frag";
+    EXPECT_EQ("1", script_lib::qs_get(url, "a"));
+    EXPECT_EQ("hello world", script_lib::qs_get(url, "b"));
+    EXPECT_FALSE(script_lib::qs_get(url, "c"));
+    EXPECT_EQ("", script_lib::qs_get("https://x.com/?flag", "flag"));
+
+    EXPECT_EQ("https://x.com/p?a=3&b=hello+world#frag", script_lib::qs_set(url, "a", "3"));
+    EXPECT_EQ("https://x.com/p?a=1&b=hello+world&a=2&c=x%20y#frag", script_lib::qs_set(url, "c", "x y"));
+    EXPECT_EQ("https://x.com/p?u=1", script_lib::qs_set("https://x.com/p", "u", "1"));
+
+    EXPECT_EQ("https://x.com/p?b=hello+world#frag", script_lib::qs_remove(url, "a"));
+    EXPECT_EQ("https://x.com/p", script_lib::qs_remove("https://x.com/p?a=1", "a"));
+}
+
+TEST(ScriptLib, RegexMatch) {
+    EXPECT_TRUE(script_lib::regex_match("https://contoso.sharepoint.com/x", R"(.*\.sharepoint\.com.*)"));
+    EXPECT_TRUE(script_lib::regex_match("HTTPS://A.COM", "https://a.com"));
+    EXPECT_FALSE(script_lib::regex_match("https://a.com/x", "https://a.com"));
+
+    // back reference, not supported by the linear engine
+    EXPECT_TRUE(script_lib::regex_match("abab", "(ab)\\1"));
+
+    string error;
+    EXPECT_FALSE(script_lib::regex_match("x", "(", &error));
+    EXPECT_NE("", error);
+
+    size_t cached = script_lib::get_cached_regex_count();
+    script_lib::regex_match("y", R"(.*\.sharepoint\.com.*)");
+    EXPECT_EQ(cached, script_lib::get_cached_regex_count());
+}
+
+TEST(ScriptLib, Lua) {
+    bt::script_site ss{R"(
+local lib = require("bt")
+
+function rule_all()
+    local u = bt.url_parse(p.url)
+    return lib == bt
+        and bt.host_is(p.url, "mail.example.com")
+        and bt.host_ends(p.url, "example.com")
+        and u.host == "mail.example.com" and u.params.q == "a b"
+        and bt.qs_get(p.url, "q") == "a b"
+        and bt.qs_get(p.url, "missing") == nil
+        and bt.qs_remove(bt.qs_set(p.url, "utm", "1"), "utm") == p.url
+        and bt.url_decode("a%20b") == "a b"
+        and bt.regex_match(p.url, ".*example.*")
+end
+
+function rule_bad_regex()
+    return bt.regex_match(p.url, "(")
+end
+)", false};
+
+    EXPECT_EQ("", ss.get_error());
+    EXPECT_TRUE(ss.call_rule(click_payload{"https://mail.example.com/x?q=a+b"}, "rule_all"));
+
+    auto l = ss.acquire();
+    string error;
+    EXPECT_FALSE(l.call_rule(click_payload{"https://x.com"}, "rule_bad_regex", &error));
+    EXPECT_NE(string::npos, error.find("invalid pattern"));
+}
+
+/**
+ * @brief Each native function against the Lua code scripts had to write without it.
+ */
+TEST(ScriptLib, DISABLED_Bench) {
+    const string lua_equivalents = R"lua(
+local N = 200000
+local url = "https://Docs.Contoso.sharepoint.com/sites/team/Shared%20Documents/file.docx?web=1&utm_source=mail&id=42#x"
+
+local function lua_host(u)
+    return string.lower(string.match(u, "^%a+://([^/?#:]+)") or u)
+end
+
+local function lua_decode(s)
+    return (string.gsub(s, "%%(%x%x)", function(h) return string.char(tonumber(h, 16)) end))
+end
+
+local function lua_qs_get(u, name)
+    local q = string.match(u, "%?([^#]*)") or ""
+    for k, v in string.gmatch(q, "([^&=]+)=?([^&]*)") do
+        if lua_decode(k) == name then return lua_decode(string.gsub(v, "%+", " ")) end
+    end
+    return nil
+end
+
+local function lua_qs_remove(u, name)
+    local base, q, frag = string.match(u, "^([^?#]*)%??([^#]*)(#?.*)$")
+    local kept = {}
+    for pair in string.gmatch(q, "[^&]+") do
+        if lua_decode(string.match(pair, "^[^=]*")) ~= name then kept[#kept + 1] = pair end
+    end
+    return base .. (#kept > 0 and "?" .. table.concat(kept, "&") or "") .. frag
+end
+
+local function lua_qs_set(u, name, value)
+    return lua_qs_remove(u, name) .. (string.find(u, "?", 1, true) and "&" or "?") .. name .. "=" .. value
+end
+
+local function lua_url_parse(u)
+    local scheme, rest = string.match(u, "^(%a+)://(.*)$")
+    rest = string.match(rest or u, "^[^#]*")
+    local hostpath, query = string.match(rest, "^([^?]*)%??(.*)$")
+    local host, path = string.match(hostpath, "^([^/]*)(.*)$")
+    local params = {}
+    for k, v in string.gmatch(query, "([^&=]+)=?([^&]*)") do params[lua_decode(k)] = lua_decode(v) end
+    return {scheme = scheme or "", host = host, path = path, query = query, params = params}
+end
+
+local function bench(name, lua_fn, native_fn)
+    local t0 = os.clock()
+    for i = 1, N do lua_fn() end
+    local t1 = os.clock()
+    for i = 1, N do native_fn() end
+    local t2 = os.clock()
+    print(string.format("%-12s lua %7.1f ms, native %7.1f ms", name, (t1 - t0) * 1000, (t2 - t1) * 1000))
+end
+
+function run()
+    bench("host_is", function() return lua_host(url) == "docs.contoso.sharepoint.com" end,
+        function() return bt.host_is(url, "docs.contoso.sharepoint.com") end)
+    bench("host_ends", function() local h = lua_host(url); return h == "sharepoint.com" or string.sub(h, -15) == ".sharepoint.com" end,
+        function() return bt.host_ends(url, "sharepoint.com") end)
+    bench("url_parse", function() return lua_url_parse(url) end, function() return bt.url_parse(url) end)
+    bench("qs_get", function() return lua_qs_get(url, "id") end, function() return bt.qs_get(url, "id") end)
+    bench("qs_set", function() return lua_qs_set(url, "id", "43") end, function() return bt.qs_set(url, "id", "43") end)
+    bench("qs_remove", function() return lua_qs_remove(url, "utm_source") end, function() return bt.qs_remove(url, "utm_source") end)
+    bench("url_decode", function() return lua_decode(url) end, function() return bt.url_decode(url) end)
+    bench("regex_match", function() return string.find(string.lower(url), "^https://[%w%.]*sharepoint%.com/") ~= nil end,
+        function() return bt.regex_match(url, "https://[a-z.]*sharepoint\\.com/.*") end)
+end
+)lua";
+
+    bt::script_site ss{lua_equivalents, false};
+    ss.on_print = [](const string& s) { cout << s << endl; };
+    ASSERT_EQ("", ss.get_error());
+    auto l = ss.acquire();
+    l.call_rule(click_payload{"https://x.com"}, "run");
+}
@@ -1,8 +1,13 @@
 #include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <filesystem>
+#include <fstream>
 #include "../bt/app/script_site.h"
 
 using namespace std;
 using namespace bt;
+namespace fs = std::filesystem;
 
 TEST(Script, Loads) {
     bt::script_site ss{R"()", false};
@@ -21,4 +26,309 @@ end
     click_payload up{"http://test.com"};
     bool matches = ss.call_rule(up, "test1");
     EXPECT_TRUE(matches);
-}
\ No newline at end of file
+}
+TEST(Script, PoolReusesStates) {
+    bt::script_site ss{R"(
+function rule_yes()
+    return true
+end
+)", false};
+
+    EXPECT_EQ(1, ss.get_state_count());
+    {
+        auto l = ss.acquire();
+        ASSERT_TRUE(l);
+        EXPECT_TRUE(l.call_rule(click_payload{"http://test.com"}, "rule_yes"));
+    }
+    {
+        auto l = ss.acquire();
+        ASSERT_TRUE(l);
+    }
+    EXPECT_EQ(1, ss.get_state_count());
+
+    // second lease while the first is out needs another state
+    auto a = ss.acquire();
+    auto b = ss.acquire();
+    EXPECT_TRUE(a && b);
+    EXPECT_EQ(2, ss.get_state_count());
+}
+
+TEST(Script, PoolEvaluatesInParallel) {
+    bt::script_site ss{R"(
+function rule_github()
+    local n = 0
+    for i = 1, 1000 do n = n + i end
+    return string.find(p.url, "github", 1, true) ~= nil
+end
+)", false};
+    ss.set_pool_size(4);
+
+    std::atomic<int> matched{0};
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 8; t++) {
+        threads.emplace_back([&ss, &matched, t]() {
+            for(int i = 0; i < 100; i++) {
+                auto l = ss.acquire();
+                click_payload up{(i + t) % 2 ? "https://github.com" : "https://gitlab.com"};
+                if(l.call_rule(up, "rule_github")) matched++;
+            }
+        });
+    }
+    for(auto& t : threads) t.join();
+
+    EXPECT_EQ(400, matched);
+    EXPECT_LE(ss.get_state_count(), 4);
+}
+
+TEST(Script, TopLevelRunsOncePerState) {
+    bt::script_site ss{R"(
+print("loaded")
+function rule_yes()
+    return true
+end
+)", false};
+    ss.set_pool_size(2);
+
+    {
+        auto a = ss.acquire();
+        auto b = ss.acquire();
+        EXPECT_TRUE(a && b);
+        EXPECT_EQ(2, ss.get_state_count());
+    }
+
+    EXPECT_EQ("loaded\nloaded\n", ss.get_print_buffer());
+}
+
+TEST(Script, GlobalsLastForTheLease) {
+    bt::script_site ss{R"(
+function rule_count()
+    calls = (calls or 0) + 1
+    return calls == 2
+end
+)", false};
+
+    auto l = ss.acquire();
+    click_payload up{"http://test.com"};
+    EXPECT_FALSE(l.call_rule(up, "rule_count"));
+    EXPECT_TRUE(l.call_rule(up, "rule_count"));
+}
+
+TEST(Script, ReloadRetiresLeasedStates) {
+    bt::script_site ss{R"(
+function rule_yes()
+    return true
+end
+)", false};
+
+    {
+        auto l = ss.acquire();
+        ss.reload();
+        EXPECT_EQ(2, ss.get_state_count());
+    }
+
+    // the state leased before reload is closed when returned
+    EXPECT_EQ(1, ss.get_state_count());
+}
+
+TEST(Script, SyntaxErrorGivesNoStates) {
+    bt::script_site ss{"function (", false};
+    EXPECT_NE("", ss.get_error());
+    EXPECT_FALSE(ss.acquire());
+    EXPECT_FALSE(ss.call_rule(click_payload{"http://test.com"}, "rule_yes"));
+}
+
+TEST(Script, UrlFields) {
+    bt::script_site ss{R"(
+function rule_fields()
+    return p.scheme == "https" and p.host == "mail.example.com" and p.path == "/inbox/1"
+        and p.query == "a=1&b=hello%20world"
+end
+
+function rule_params()
+    return p.params.a == "1" and p.params.b == "hello world" and p.params.c == nil
+end
+
+function rule_no_path()
+    return p.scheme == "" and p.host == "example.com" and p.path == "" and p.query == "x"
+end
+)", false};
+
+    EXPECT_TRUE(ss.call_rule(click_payload{"https://mail.example.com/inbox/1?a=1&b=hello%20world#top"}, "rule_fields"));
+    EXPECT_TRUE(ss.call_rule(click_payload{"https://mail.example.com/inbox/1?a=1&b=hello%20world#top"}, "rule_params"));
+    EXPECT_TRUE(ss.call_rule(click_payload{"example.com?x"}, "rule_no_path"));
+}
+
+TEST(Script, UrlFieldsAreParsedPerCall) {
+    bt::script_site ss{R"(
+function ppl_host()
+    return p.host
+end
+)", false};
+
+    auto l = ss.acquire();
+    EXPECT_EQ("a.com", l.call_ppl(click_payload{"https://a.com/x"}, "ppl_host"));
+    EXPECT_EQ("b.com", l.call_ppl(click_payload{"https://b.com"}, "ppl_host"));
+}
+
+TEST(Script, DiscoversDefinedFunctions) {
+    bt::script_site ss{R"(
+-- function rule_commented_out()
+local function helper() return true end
+
+function rule_first()
+    return helper()
+end
+
+ppl_assigned = function()
+    return nil
+end
+
+function other() end
+)", false};
+
+    EXPECT_EQ((vector<string>{"rule_first", "ppl_assigned", "other"}), ss.get_function_names());
+    EXPECT_EQ((vector<string>{"rule_first", "ppl_assigned"}), ss.get_bt_function_names());
+    EXPECT_EQ((vector<string>{"rule_first"}), ss.get_rule_function_names());
+    EXPECT_EQ((vector<string>{"ppl_assigned"}), ss.get_ppl_function_names());
+    EXPECT_FALSE(ss.is_from_cache());
+}
+
+TEST(Script, ChunkCache) {
+    fs::path path = fs::temp_directory_path() / "bt_script_site_test.lua";
+    {
+        ofstream out{path, ios::trunc};
+        out << "function rule_yes() return true end\nfunction ppl_none() return nil end\n";
+    }
+    fs::remove(path.string() + ".cache");
+
+    {
+        bt::script_site cold{path.string(), true};
+        EXPECT_FALSE(cold.is_from_cache());
+        EXPECT_TRUE(fs::exists(cold.get_cache_path()));
+    }
+
+    bt::script_site warm{path.string(), true};
+    EXPECT_TRUE(warm.is_from_cache());
+    EXPECT_EQ((vector<string>{"rule_yes", "ppl_none"}), warm.get_function_names());
+    EXPECT_TRUE(warm.call_rule(click_payload{"http://test.com"}, "rule_yes"));
+
+    // changed code is compiled again
+    warm.set_code("function rule_no() return false end\n");
+    EXPECT_FALSE(warm.is_from_cache());
+    EXPECT_EQ((vector<string>{"rule_no"}), warm.get_function_names());
+
+    // damaged cache is ignored
+    {
+        fstream f{warm.get_cache_path(), ios::binary | ios::in | ios::out};
+        f.seekp(-4, ios::end);
+        f << "junk";
+    }
+    warm.reload();
+    EXPECT_FALSE(warm.is_from_cache());
+    EXPECT_EQ((vector<string>{"rule_no"}), warm.get_rule_function_names());
+    EXPECT_FALSE(warm.call_rule(click_payload{"http://test.com"}, "rule_no"));
+
+    fs::remove(warm.get_cache_path());
+    fs::remove(path);
+}
+
+TEST(Script, HotSwapKeepsLeasedProgram) {
+    fs::path path = fs::temp_directory_path() / "bt_script_site_swap.lua";
+    {
+        ofstream out{path, ios::trunc};
+        out << "function rule_v() return false end\n";
+    }
+
+    bt::script_site ss{path.string(), true};
+    click_payload up{"http://test.com"};
+    auto old_lease = ss.acquire();
+
+    {
+        ofstream out{path, ios::trunc};
+        out << "function rule_v() return true end\nfunction rule_new() return true end\n";
+    }
+
+    // as the file watcher does
+    bool reloaded{false};
+    thread{[&]() { reloaded = ss.reload_if_changed(); }}.join();
+    EXPECT_TRUE(reloaded);
+    EXPECT_EQ((vector<string>{"rule_v", "rule_new"}), ss.get_rule_function_names());
+
+    // a click in flight finishes with what it started with, new ones see the new code
+    EXPECT_FALSE(old_lease.call_rule(up, "rule_v"));
+    EXPECT_TRUE(ss.acquire().call_rule(up, "rule_v"));
+
+    // unchanged file is not loaded again
+    EXPECT_FALSE(ss.reload_if_changed());
+
+    fs::remove(ss.get_cache_path());
+    fs::remove(path);
+}
+
+TEST(Script, PrintBufferIsBounded) {
+    bt::script_site ss{R"(
+function rule_spam()
+    for i = 1, 10000 do
+        print(string.rep("x", 99))
+    end
+    print("last")
+    return true
+end
+)", false};
+
+    EXPECT_TRUE(ss.call_rule(click_payload{"http://test.com"}, "rule_spam"));
+    string b = ss.get_print_buffer();
+    EXPECT_LE(b.size(), script_site::MaxPrintBytes);
+    EXPECT_GT(b.size(), script_site::MaxPrintBytes / 2);
+    EXPECT_TRUE(b.ends_with("x\nlast\n"));
+
+    ss.clear_print_buffer();
+    EXPECT_EQ("", ss.get_print_buffer());
+}
+
+TEST(Script, MemoryAccounting) {
+    bt::script_site ss{R"(
+function rule_grow()
+    big = {}
+    for i = 1, 100000 do big[i] = i end
+    return true
+end
+
+function rule_free()
+    big = nil
+    collectgarbage()
+    return true
+end
+)", false};
+
+    click_payload up{"http://test.com"};
+    size_t base = ss.get_memory_usage();
+    EXPECT_GT(base, 0);
+
+    EXPECT_TRUE(ss.call_rule(up, "rule_grow"));
+    size_t grown = ss.get_memory_usage();
+    EXPECT_GT(grown, base + 1024 * 1024);
+
+    EXPECT_TRUE(ss.call_rule(up, "rule_free"));
+    EXPECT_LT(ss.get_memory_usage(), base + 256 * 1024);
+    EXPECT_GE(ss.get_peak_memory_usage(), grown);
+}
+
+TEST(Script, GcMode) {
+    bt::script_site ss{R"(
+function rule_yes()
+    return true
+end
+)", false};
+
+    EXPECT_EQ(script_site::gc_mode::incremental, ss.get_gc_mode());
+
+    auto l = ss.acquire();
+    ss.set_gc(script_site::gc_mode::generational);
+    EXPECT_EQ(script_site::gc_mode::generational, ss.get_gc_mode());
+    EXPECT_TRUE(l.call_rule(click_payload{"http://test.com"}, "rule_yes"));
+
+    ss.set_gc(script_site::gc_mode::incremental, 10);
+    EXPECT_EQ(10, ss.get_gc_step_size());
+    EXPECT_TRUE(ss.call_rule(click_payload{"http://test.com"}, "rule_yes"));
+}
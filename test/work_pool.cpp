@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include "../bt/app/matching/work_pool.h"
+
+using namespace std;
+using namespace bt::matching;
+
+TEST(WorkPool, CoversEveryItemOnce) {
+    work_pool pool{3};
+    vector<atomic<int>> seen(10000);
+    pool.parallel_for(seen.size(), 64, [&](size_t participant, size_t begin, size_t end) {
+        EXPECT_LT(participant, pool.get_participant_count());
+        EXPECT_LE(end - begin, 64);
+        for(size_t i = begin; i < end; i++) seen[i]++;
+    });
+    for(size_t i = 0; i < seen.size(); i++) EXPECT_EQ(1, seen[i].load()) << i;
+}
+
+TEST(WorkPool, UnevenWorkIsStolen) {
+    work_pool pool{3};
+    vector<atomic<int>> seen(2000);
+    pool.parallel_for(seen.size(), 8, [&](size_t, size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) {
+            // all the cost is in the first share
+            if(i < 500) this_thread::sleep_for(chrono::microseconds(50));
+            seen[i]++;
+        }
+    });
+    for(size_t i = 0; i < seen.size(); i++) EXPECT_EQ(1, seen[i].load()) << i;
+}
+
+TEST(WorkPool, ReusedForManyCalls) {
+    work_pool pool{2};
+    for(int round = 0; round < 200; round++) {
+        atomic<size_t> sum{0};
+        pool.parallel_for(1000, 16, [&](size_t, size_t begin, size_t end) {
+            for(size_t i = begin; i < end; i++) sum += i;
+        });
+        ASSERT_EQ(999 * 1000 / 2, sum.load());
+    }
+}
+
+TEST(WorkPool, RethrowsFirstError) {
+    work_pool pool{3};
+    EXPECT_THROW(pool.parallel_for(1000, 10, [](size_t, size_t begin, size_t) {
+        if(begin == 500) throw runtime_error("bad item");
+    }), runtime_error);
+
+    // still usable afterwards
+    atomic<size_t> count{0};
+    pool.parallel_for(1000, 10, [&](size_t, size_t begin, size_t end) { count += end - begin; });
+    EXPECT_EQ(1000, count.load());
+}
+
+TEST(WorkPool, NoThreadsRunsOnCaller) {
+    work_pool pool{0};
+    EXPECT_EQ(1, pool.get_participant_count());
+    vector<size_t> begins;
+    pool.parallel_for(100, 30, [&](size_t participant, size_t begin, size_t end) {
+        EXPECT_EQ(0, participant);
+        begins.push_back(begin);
+    });
+    EXPECT_EQ((vector<size_t>{0, 30, 60, 90}), begins);
+}
+
+TEST(WorkPool, DISABLED_Bench) {
+    // per-item cost roughly that of a substring rule, to find where waking the pool up starts to pay off
+    auto work = [](size_t begin, size_t end) {
+        volatile size_t x{0};
+        for(size_t i = begin; i < end; i++) {
+            for(int k = 0; k < 20; k++) x = x + i * k;
+        }
+    };
+
+    work_pool& pool = work_pool::get();
+    for(size_t count : {1000, 2000, 4000, 8000, 16000, 32000, 64000}) {
+        auto t0 = chrono::steady_clock::now();
+        for(int round = 0; round < 100; round++) work(0, count);
+        auto serial = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - t0).count();
+
+        t0 = chrono::steady_clock::now();
+        for(int round = 0; round < 100; round++) {
+            pool.parallel_for(count, 512, [&](size_t, size_t begin, size_t end) { work(begin, end); });
+        }
+        auto parallel = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - t0).count();
+
+        cout << count << " items on " << pool.get_participant_count() << " threads: serial " << serial
+            << " us, parallel " << parallel << " us" << endl;
+    }
+}